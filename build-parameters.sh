@@ -15,5 +15,10 @@ INSTALL_LOCATION="/usr/local"
 
 library "cairo"
 library "x11"
+library "xext"
 library "freetype2"
 library "xkbcommon"
+
+# files are saved on a separate thread
+FLAGS_CFLAGS="$FLAGS_CFLAGS -pthread"
+FLAGS_LIBS="$FLAGS_LIBS -pthread"
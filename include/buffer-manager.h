@@ -7,3 +7,4 @@ size_t      BufferManager_add    (EditBuffer *);
 size_t      BufferManager_addNew (void);
 Error       BufferManager_delete (size_t);
 EditBuffer *BufferManager_get    (size_t);
+void        BufferManager_flushJournals (void);
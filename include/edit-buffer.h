@@ -1,15 +1,27 @@
 #pragma once
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 #include "safe-string.h"
 #include "error.h"
 
-typedef struct EditBuffer_Cursor EditBuffer_Cursor;
-typedef struct EditBuffer        EditBuffer;
-
-// TODO: remove this limit, and dynamically allocate cursors array
-#define EDITBUFFER_MAX_CURSORS 32
+typedef struct EditBuffer_Cursor   EditBuffer_Cursor;
+typedef struct EditBuffer_Edit     EditBuffer_Edit;
+typedef struct EditBuffer_Delta    EditBuffer_Delta;
+typedef struct EditBuffer_History  EditBuffer_History;
+typedef struct EditBuffer_Piece    EditBuffer_Piece;
+typedef struct EditBuffer_Original EditBuffer_Original;
+typedef struct EditBuffer_Changes  EditBuffer_Changes;
+typedef struct EditBuffer_Load     EditBuffer_Load;
+typedef struct EditBuffer_Save     EditBuffer_Save;
+typedef struct EditBuffer_Journal  EditBuffer_Journal;
+typedef struct EditBuffer_Follow   EditBuffer_Follow;
+typedef struct EditBuffer          EditBuffer;
 
 typedef enum {
         EditBuffer_Direction_left,
@@ -26,19 +38,290 @@ struct EditBuffer_Cursor {
         EditBuffer *parent;
         
         int hasSelection;
+
+        // how many of the edits recorded during the current batch operation
+        // this cursor has been moved along with
+        size_t batchEdits;
+};
+
+/* EditBuffer_Edit
+ * Describes a change to the text of the buffer: everything from the start up
+ * to the old end was replaced by text that goes from the start up to the new
+ * end. Cursors are moved along with the text around them using these.
+ */
+struct EditBuffer_Edit {
+        size_t startColumn;
+        size_t startRow;
+        size_t oldEndColumn;
+        size_t oldEndRow;
+        size_t newEndColumn;
+        size_t newEndRow;
+};
+
+/* EditBuffer_Delta
+ * One entry in the undo history: text that was inserted at, or deleted from,
+ * the buffer. The text goes from the start to the end position, and is kept in
+ * the text buffer of the history. Line breaks in it are stored as '\n'.
+ */
+struct EditBuffer_Delta {
+        size_t startColumn;
+        size_t startRow;
+        size_t endColumn;
+        size_t endRow;
+        size_t textStart;
+        size_t textLength;
+
+        uint8_t deleted;
+        // set on the first delta of each group of deltas that are undone and
+        // redone together
+        uint8_t startsGroup;
+};
+
+/* EditBuffer_History
+ * The undo history of an edit buffer. Deltas before current have been done,
+ * and deltas from current onward have been undone and can be redone. Once the
+ * history takes up more than Options_undoLimit bytes, the oldest groups of
+ * deltas are dropped.
+ */
+struct EditBuffer_History {
+        EditBuffer_Delta *deltas;
+        size_t            amountOfDeltas;
+        size_t            deltasSize;
+        size_t            current;
+
+        char   *text;
+        size_t  textLength;
+        size_t  textSize;
+
+        // grouping is set during batch operations, so that everything they
+        // do ends up in one group
+        int grouping;
+        int groupStarted;
+        // set while undoing or redoing, so nothing gets recorded
+        int replaying;
+        // set after undoing or redoing, so the next delta is not coalesced
+        // into one from before
+        int sealed;
+};
+
+/* EditBuffer_Piece
+ * A node in the piece tree. Each piece either spans a run of untouched lines in
+ * the original file buffer, or holds a single line that has been materialized
+ * into a String so it can be edited. Pieces are kept in a treap ordered by line
+ * position, and weighted by the amount of lines in each subtree, so any line
+ * can be found, inserted, or removed in O(log n) time.
+ */
+struct EditBuffer_Piece {
+        EditBuffer_Piece *left;
+        EditBuffer_Piece *right;
+        uint32_t          priority;
+        size_t            subtreeLength;
+
+        size_t  start;
+        size_t  length;
+        String *line;
+};
+
+/* EditBuffer_LineIndex
+ * The byte offsets of the starts of lines in the original file buffer. Usually
+ * the start of every line is kept, but if stride is more than one, only one out
+ * of every stride lines is, and rows holds the row of each one. The rest are
+ * found by looking for line breaks from the closest one before them. This keeps
+ * the index of a huge file small. amountOfLines is how many lines there are in
+ * all.
+ */
+typedef struct {
+        size_t *starts;
+        size_t *rows;
+        size_t  amountOfStarts;
+        size_t  amountOfLines;
+        size_t  stride;
+} EditBuffer_LineIndex;
+
+/* EditBuffer_Original
+ * The contents of the file as it was loaded or last saved, along with an index
+ * of the starts of the lines in it. The contents are never modified once they
+ * are read in. The file they came from is at device and inode. If mapped is
+ * set, data points directly into a read-only memory mapping of that file. If
+ * the index is sparse, the start of the last line that was looked up is kept in
+ * hintRow and hintStart, since lines are usually looked up in order.
+ */
+struct EditBuffer_Original {
+        char   *data;
+        size_t  size;
+        int     mapped;
+        dev_t   device;
+        ino_t   inode;
+        
+        EditBuffer_LineIndex lines;
+        size_t               hintRow;
+        size_t               hintStart;
+};
+
+/* EditBuffer_Changes
+ * Describes how the lines of the buffer have changed since they were last
+ * taken with EditBuffer_takeChanges, so that views of it only need to update
+ * what actually changed. The lines from start to oldEnd were replaced by the
+ * lines from start to newEnd, and every line after them was moved along with
+ * them. If all is set, every line should be considered changed.
+ */
+struct EditBuffer_Changes {
+        int    changed;
+        int    all;
+        size_t start;
+        size_t oldEnd;
+        size_t newEnd;
 };
 
+/* EditBuffer_Load
+ * The rest of a file that is still being indexed. When a big file is opened,
+ * only enough of it to fill the first screen is indexed right away, and the
+ * buffer spans just those lines. The line starts of the rest of the file are
+ * found on a worker thread, and the lines are added onto the end of the buffer
+ * by EditBuffer_finishLoad. The file is kept open until then, since unsaved
+ * work in its journal can only be put back once the whole file is there.
+ */
+struct EditBuffer_Load {
+        pthread_t  thread;
+        int        running;
+        atomic_int finished;
+        int        file;
+
+        size_t               start;
+        EditBuffer_LineIndex lines;
+};
+
+/* EditBuffer_Save
+ * A save of the buffer that is being written out. When a save starts, the
+ * contents of the buffer are frozen into a list of byte ranges to write: lines
+ * that haven't been touched point straight into the original file buffer, which
+ * never changes, and only lines that have been edited are copied into text.
+ * The file is then written on a worker thread, so the buffer can keep being
+ * edited in the meantime. Once it is written, the worker reads the saved file
+ * back into saved and indexes it, so that the buffer can be based on the saved
+ * file afterwards. See EditBuffer_rebaseJournal.
+ */
+struct EditBuffer_Save {
+        pthread_t  thread;
+        int        running;
+        atomic_int finished;
+        Error      result;
+
+        struct iovec *parts;
+        size_t        amountOfParts;
+        char         *text;
+        size_t        textLength;
+
+        mode_t mode;
+        char   filePath[PATH_MAX + 1];
+
+        EditBuffer_Original saved;
+};
+
+/* EditBuffer_JournalHeader
+ * The start of every journal file. It identifies the file that the journal was
+ * started against, so that a journal is never replayed onto a file that has
+ * changed since then.
+ */
+typedef struct {
+        char     magic[8];
+        uint64_t device;
+        uint64_t inode;
+        uint64_t size;
+        uint64_t modifiedSeconds;
+        uint64_t modifiedNanoseconds;
+} EditBuffer_JournalHeader;
+
+/* EditBuffer_Journal
+ * A log of the edits made to the buffer, kept in a file next to the one being
+ * edited, so that unsaved work can be recovered if the editor dies. Edits are
+ * queued up in pending, and written out in batches by EditBuffer_flushJournal.
+ * Once the journal grows past Options_journalLimit, it is compacted into a
+ * checkpoint listing which lines of the original file buffer are still there,
+ * along with the text of every edited line. length is how long the journal is
+ * on disk, header included, even if the file hasn't been made yet.
+ */
+struct EditBuffer_Journal {
+        int    file;
+        size_t length;
+        char   filePath[PATH_MAX + 1];
+
+        EditBuffer_JournalHeader header;
+
+        char   *pending;
+        size_t  pendingLength;
+        size_t  pendingSize;
+
+        // set while the journal is being replayed, so nothing gets recorded
+        int replaying;
+        // set while the header refers to the file the original file buffer
+        // was read from. checkpoints can only point into it while this is
+        // set, so the journal isn't compacted while it is unset.
+        int matchesOriginal;
+        // how long the journal was right after it was last compacted, so a
+        // checkpoint that is already big isn't written out again and again
+        size_t compactedLength;
+        // set while a save is being written. saveStart is how long the journal
+        // was when the buffer was frozen for it.
+        int    saving;
+        size_t saveStart;
+};
+
+/* EditBuffer_Follow
+ * A file that is being followed as it grows, like a log that is still being
+ * written to. The file is watched with inotify, and when it changes, only the
+ * bytes from offset onward are read in and added onto the end of the buffer.
+ * The buffer is read only, so its last line always lines up with whatever comes
+ * after the last line break read so far.
+ */
+struct EditBuffer_Follow {
+        int    watch;
+        int    file;
+        size_t offset;
+        // set if the file changed since it was last read, or if there was
+        // more to read than could be read in one go
+        int    behind;
+};
+
+/* EditBuffer
+ * A buffer of lines of text, with any amount of cursors in it. Cursors are kept
+ * sorted by position, and no two of them are ever in the same place once an
+ * operation on them is finished. The primary cursor is the one that was there
+ * first, and it is never removed in favor of another.
+ */
 struct EditBuffer {
-        EditBuffer_Cursor cursors[EDITBUFFER_MAX_CURSORS];
-        size_t            amountOfCursors;
+        EditBuffer_Cursor *cursors;
+        size_t             amountOfCursors;
+        size_t             cursorsSize;
+        size_t             primaryCursor;
         
         size_t scroll;
         
-        size_t length;
-        size_t size;
-        String **lines;
+        size_t               length;
+        EditBuffer_Piece    *pieces;
+        EditBuffer_Original  original;
+        String              *peekedLine;
 
-        int dontMerge;
+        EditBuffer_Changes changes;
+        EditBuffer_History history;
+        EditBuffer_Load    load;
+        EditBuffer_Save    save;
+        EditBuffer_Journal journal;
+        EditBuffer_Follow  follow;
+
+        // set if the buffer is only being viewed. nothing can edit or save it.
+        int readOnly;
+
+        // while an operation is being done on all cursors, edits only move
+        // the cursor doing them. they are recorded here, and the rest of the
+        // cursors are moved along with them all at once when it is over.
+        int                batching;
+        EditBuffer_Cursor *batchCursor;
+        EditBuffer_Edit   *edits;
+        size_t             amountOfEdits;
+        size_t             editsSize;
+        size_t             editsStartColumn;
+        size_t             editsStartRow;
 
         char filePath[PATH_MAX + 1];
 };
@@ -46,14 +329,29 @@ struct EditBuffer {
 EditBuffer *EditBuffer_new  (void);
 void        EditBuffer_free (EditBuffer *);
 
+void EditBuffer_onWorkerFinish (void (*) (void));
+
 Error EditBuffer_open              (EditBuffer *, const char *);
+Error EditBuffer_openReadOnly      (EditBuffer *, const char *);
+Error EditBuffer_openFollowing     (EditBuffer *, const char *);
+int   EditBuffer_isFollowing       (EditBuffer *);
+int   EditBuffer_updateFollow      (EditBuffer *);
+void  EditBuffer_finishLoad        (EditBuffer *);
+int   EditBuffer_isLoading         (EditBuffer *);
+Error EditBuffer_save              (EditBuffer *);
+Error EditBuffer_finishSave        (EditBuffer *);
+int   EditBuffer_isSaving          (EditBuffer *);
+void  EditBuffer_flushJournal      (EditBuffer *);
 void  EditBuffer_copy              (EditBuffer *, const char *);
 void  EditBuffer_reset             (EditBuffer *);
+void  EditBuffer_takeChanges       (EditBuffer *, EditBuffer_Changes *);
 void  EditBuffer_clearExtraCursors (EditBuffer *);
 void  EditBuffer_addNewCursor      (EditBuffer *, size_t, size_t);
+EditBuffer_Cursor *EditBuffer_getPrimaryCursor (EditBuffer *);
 int   EditBuffer_hasCursorAt       (EditBuffer *, size_t, size_t);
 int   EditBuffer_hasSelectionAt    (EditBuffer *, size_t, size_t);
 void  EditBuffer_insertRuneAt      (EditBuffer *, size_t, size_t, Rune);
+void  EditBuffer_insertStringAt    (EditBuffer *, size_t, size_t, String *);
 void  EditBuffer_deleteRuneAt      (EditBuffer *, size_t, size_t);
 void  EditBuffer_deleteRange (
         EditBuffer *,
@@ -61,8 +359,11 @@ void  EditBuffer_deleteRange (
         size_t, size_t);
 
 void EditBuffer_scroll (EditBuffer *, int);
+void EditBuffer_undo   (EditBuffer *);
+void EditBuffer_redo   (EditBuffer *);
 
-String *EditBuffer_getLine (EditBuffer *, size_t);
+String *EditBuffer_getLine  (EditBuffer *, size_t);
+String *EditBuffer_peekLine (EditBuffer *, size_t);
 
 void EditBuffer_cursorsInsertRune      (EditBuffer *, Rune);
 void EditBuffer_cursorsDeleteSelection (EditBuffer *);
@@ -7,8 +7,10 @@ typedef enum {
         Error_cantSetName,
         Error_cantMapWindow,
         Error_cantOpenFile,
+        Error_cantSaveFile,
         Error_cantInitFreetype,
         Error_cantLoadFont,
         Error_outOfBounds,
-        Error_nullObject
+        Error_nullObject,
+        Error_cantWatchFile
 } Error;
@@ -14,13 +14,20 @@ typedef struct Interface_EditViewRuler  Interface_EditViewRuler;
 typedef struct Interface_EditViewText   Interface_EditViewText;
 typedef struct Interface                Interface;
 
-Error Interface_run           (void);
-void  Interface_setEditBuffer (EditBuffer *newEditBuffer);
+Error Interface_run              (void);
+void  Interface_setEditBuffer    (EditBuffer *newEditBuffer);
+void  Interface_followEditBuffer (EditBuffer *, size_t);
+Error Interface_watchFile        (int);
+void  Interface_unwatchFile      (int);
+void  Interface_wake             (void);
 
 Interface_Tab *Interface_tabBar_add       (size_t, const char *);
 void           Interface_tabBar_delete    (Interface_Tab *);
 void           Interface_tabBar_setActive (Interface_Tab *);
+Interface_Tab *Interface_tabBar_getFirst  (void);
 void           Interface_Tab_setText      (Interface_Tab *, const char *);
+void           Interface_Tab_setLoading   (Interface_Tab *, int);
+void           Interface_Tab_setSaveFailed (Interface_Tab *, int);
 size_t         Interface_Tab_getBufferId  (Interface_Tab *);
 Interface_Tab *Interface_Tab_getPrevious  (Interface_Tab *);
 Interface_Tab *Interface_Tab_getNext      (Interface_Tab *);
@@ -30,5 +37,8 @@ void Interface_onStart     (void (*) (void));
 void Interface_onNewTab    (void (*) (void));
 void Interface_onCloseTab  (void (*) (Interface_Tab *));
 void Interface_onSwitchTab (void (*) (Interface_Tab *));
+void Interface_onInterval  (void (*) (void));
+void Interface_onFile      (void (*) (int));
+void Interface_onWake      (void (*) (void));
 
 // make event handlers for creating a new tab, clicking on a tab, etc
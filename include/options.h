@@ -9,6 +9,12 @@ extern int    Options_scrollSize;
 extern int    Options_cursorSize;
 extern int    Options_fontSize;
 extern char  *Options_fontName;
+extern size_t Options_undoLimit;
+extern size_t Options_journalLimit;
+extern size_t Options_readOnlySize;
+extern int    Options_sharedMemory;
+extern int    Options_glyphAtlas;
+extern size_t Options_glyphAtlasSize;
 
 void Options_start (void);
 
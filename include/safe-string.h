@@ -4,19 +4,46 @@
 #include <stdint.h>
 #include "unicode.h"
 
+// a checkpoint is kept every STRING_CHECKPOINT_INTERVAL runes, so that finding
+// the byte offset of a rune never has to scan more than this many runes.
+#define STRING_CHECKPOINT_INTERVAL 64
+
+/* String
+ * A string of UTF-8 text. Positions and lengths are always measured in runes,
+ * but the text is stored as UTF-8, so that mostly-ASCII text takes up a quarter
+ * of the memory it would as an array of runes. To keep rune lookups fast, the
+ * byte offset of every STRING_CHECKPOINT_INTERVALth rune is indexed lazily, and
+ * the last lookup is cached so walking through a string in order is cheap.
+ * Strings that are entirely ASCII skip all of this, since their rune and byte
+ * offsets are the same.
+ */
 typedef struct {
         size_t size;
         size_t length;
-        Rune  *buffer;
+        size_t byteLength;
+        char  *buffer;
+
+        size_t *checkpoints;
+        size_t  checkpointsSize;
+        size_t  checkpointsValid;
+
+        size_t cachedIndex;
+        size_t cachedOffset;
 } String;
 
 String *String_new   (const char *);
 void    String_free  (String *);
 void    String_clear (String *);
 
-void String_addBuffer (String *, const char *);
-void String_addString (String *, String *);
-void String_addRune   (String *, Rune);
+Rune   String_getRune   (String *, size_t);
+size_t String_getOffset (String *, size_t);
+
+void String_addBuffer     (String *, const char *);
+void String_addBytes      (String *, const char *, size_t);
+void String_addValidBytes (String *, const char *, size_t, size_t);
+void String_addString     (String *, String *);
+void String_addByteRange  (String *, String *, size_t, size_t);
+void String_addRune       (String *, Rune);
 
 void String_insertBuffer (String *, const char *, size_t);
 void String_insertString (String *, String *, size_t);
@@ -22,22 +22,68 @@ typedef struct {
         size_t                  realColumn;
 } TextDisplay_Cell;
 
+/* TextDisplay_Span
+ * A range of columns on a row of the display, inclusive. For cursors, start and
+ * end are the same.
+ */
+typedef struct {
+        size_t row;
+        size_t start;
+        size_t end;
+} TextDisplay_Span;
+
+/* TextDisplay_Spans
+ * A list of spans sorted by row and then by column, along with the index of the
+ * first span on each row of the display.
+ */
+typedef struct {
+        TextDisplay_Span *spans;
+        size_t            amount;
+        size_t            size;
+        size_t           *rowStarts;
+} TextDisplay_Spans;
+
 typedef struct {
         EditBuffer *model;
 
         size_t width;
         size_t height;
 
-        size_t lastRow;
         size_t lastRealRow;
         size_t lastRealColumn;
         
         TextDisplay_Cell *cells;
+
+        // the scroll value of the model when it was last grabbed, and whether
+        // the entire display needs to be grabbed next time regardless of what
+        // changed in the model
+        size_t grabbedScroll;
+        int    needsFullGrab;
+
+        // how many rows everything has moved up by since the last time this
+        // was taken, or down if it is negative. rows that only moved because
+        // the model scrolled aren't damaged, since whatever is on screen is
+        // expected to be moved along with them.
+        int shiftedRows;
+
+        // rows that need to be grabbed, and rows that had cursors or
+        // selections on them when they were last grabbed
+        uint8_t *dirtyRows;
+        uint8_t *cursorRows;
+
+        // the cells as they were before rows were moved around
+        TextDisplay_Cell *previousCells;
+
+        // where the cursors and selections of the model are on screen, worked
+        // out once per grab
+        TextDisplay_Spans cursorSpans;
+        TextDisplay_Spans selectionSpans;
 } TextDisplay;
 
 TextDisplay *TextDisplay_new           (EditBuffer *, size_t, size_t);
 void         TextDisplay_free          (TextDisplay *);
 void         TextDisplay_grab          (TextDisplay *);
+int          TextDisplay_takeShift     (TextDisplay *);
 void         TextDisplay_setModel      (TextDisplay *, EditBuffer *);
 void         TextDisplay_resize        (TextDisplay *, size_t, size_t);
 void         TextDisplay_getRealCoords (
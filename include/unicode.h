@@ -22,7 +22,20 @@ typedef uint32_t Rune;
 #define UTF8_CONTINUE_MASK        0b11000000
 #define UTF8_CONTINUE_INVERT_MASK ~UTF8_CONTINUE_MASK
 
+// bytes that are not part of valid UTF-8 text are each stored as a rune in the
+// range U+DC00 - U+DCFF, which real text can never contain. this way they can
+// be drawn as errors, and still be written back out exactly as they were.
+#define UNICODE_BAD_BYTE_BASE 0xDC00
+#define Unicode_badByteToRune(byte) \
+        (UNICODE_BAD_BYTE_BASE | (Rune)((uint8_t)(byte)))
+#define Unicode_runeToBadByte(rune) ((uint8_t)((rune) & 0xFF))
+#define Unicode_isBadByte(rune) \
+        (((rune) & ~(Rune)(0xFF)) == UNICODE_BAD_BYTE_BASE)
+
 size_t Unicode_utf8CodepointSize (uint8_t ch);
 Rune   Unicode_utf8ToRune        (const char *, size_t *);
 Rune   Unicode_utf8FileGetRune   (FILE *, int *); 
 Rune   Unicode_utf8ArrayToRune   (const uint8_t[4], size_t);
+size_t Unicode_runeToUtf8        (Rune, uint8_t[4]);
+size_t Unicode_utf8Validate      (const char *, size_t, size_t *);
+size_t Unicode_utf8CountRunes    (const char *, size_t);
@@ -1,4 +1,5 @@
 #pragma once
+#include <time.h>
 #include <cairo.h>
 #include <stdlib.h>
 #include "error.h"
@@ -80,6 +81,8 @@ typedef unsigned long Window_KeySym;
 extern cairo_surface_t *Window_surface;
 extern cairo_t         *Window_context;
 extern time_t           Window_interval;
+extern time_t           Window_frameInterval;
+extern int              Window_sharedMemory;
 
 Error Window_start    (void);
 Error Window_show     (void);
@@ -87,8 +90,19 @@ Error Window_listen   (void);
 Error Window_stop     (void);
 Error Window_setTitle (const char *);
 
-void Window_onRedraw      (void (*) (int, int, int));
-void Window_onMouseButton (void (*) (int, Window_MouseButton, Window_State));
-void Window_onMouseMove   (void (*) (int, int, int));
-void Window_onInterval    (void (*) (int));
-void Window_onKey         (void (*) (int, Window_KeySym, Rune, Window_State));
+Error  Window_addFile      (int, void (*) (int));
+void   Window_removeFile   (int);
+size_t Window_addTimer     (time_t, time_t, void (*) (void *), void *);
+void   Window_removeTimer  (size_t);
+void   Window_wake         (void);
+void   Window_requestFrame (void);
+void   Window_damage       (double, double, double, double);
+void   Window_scrollArea   (double, double, double, double, int);
+
+void Window_onRedraw      (void (*) (int, int));
+void Window_onMouseButton (void (*) (Window_MouseButton, Window_State));
+void Window_onMouseMove   (void (*) (int, int));
+void Window_onInterval    (void (*) (void));
+void Window_onKey         (void (*) (Window_KeySym, Rune, Window_State));
+void Window_onWake        (void (*) (void));
+void Window_onFrame       (void (*) (void));
@@ -49,3 +49,10 @@ EditBuffer *BufferManager_get (size_t index) {
         if (index >= store.size) { return NULL; }
         return store.list[index];
 }
+
+void BufferManager_flushJournals (void) {
+        for (size_t index = 0; index < store.size; index ++) {
+                if (store.list[index] == NULL) { continue; }
+                EditBuffer_flushJournal(store.list[index]);
+        }
+}
@@ -102,7 +102,7 @@ void EditBuffer_Cursor_predictMovement (
                 amountV,
                 cursor->parent->length);
 
-        size_t lineLength = EditBuffer_getLine (
+        size_t lineLength = EditBuffer_peekLine (
                 cursor->parent,
                 *resultRow)->length;
         if (*resultRow == rowBefore && amountV != 0) {
@@ -127,7 +127,7 @@ void EditBuffer_Cursor_predictMovement (
         if (*resultColumn == 0 && amountH < 0) {
                 if (*resultRow > 0) {
                         *resultRow -= 1;
-                        lineLength = EditBuffer_getLine (
+                        lineLength = EditBuffer_peekLine (
                                 cursor->parent, *resultRow
                         )->length;
                         *resultColumn = lineLength;
@@ -136,7 +136,7 @@ void EditBuffer_Cursor_predictMovement (
         }
 
         // if we have gone off the end of the line, wrap around to the next one.
-        lineLength = EditBuffer_getLine (
+        lineLength = EditBuffer_peekLine (
                 cursor->parent,
                 *resultRow)->length;
         if (*resultColumn >= lineLength && amountH > 0) {
@@ -338,7 +338,25 @@ void EditBuffer_Cursor_selectNone (EditBuffer_Cursor *cursor) {
 
 // TODO
 void EditBuffer_Cursor_changeIndent (EditBuffer_Cursor *cursor, int);
-void EditBuffer_Cursor_insertString (EditBuffer_Cursor *cursor, String *string);
+
+/* EditBuffer_Cursor_insertString
+ * Inserts a string at the current cursor position, replacing the selection if
+ * there is one. The cursor ends up after the inserted text. If there are no
+ * lines in the edit buffer, this function does nothing.
+ */
+void EditBuffer_Cursor_insertString (
+        EditBuffer_Cursor *cursor,
+        String *string
+) {
+        if (cursor->parent->length == 0) { return; }
+        if (cursor->hasSelection) {
+                EditBuffer_Cursor_deleteSelection(cursor);
+        }
+        EditBuffer_insertStringAt (
+                cursor->parent,
+                cursor->column, cursor->row,
+                string);
+}
 
 /* EditBuffer_Cursor_wrangle
  * Moves cursor within bounds. If there are no lines in the edit buffer, this
@@ -350,12 +368,12 @@ void EditBuffer_Cursor_wrangle (EditBuffer_Cursor *cursor) {
         
         if (cursor->row >= cursor->parent->length) {
                 cursor->row = cursor->parent->length - 1;
-                line = EditBuffer_Cursor_getCurrentLine(cursor);
+                line = EditBuffer_peekLine(cursor->parent, cursor->row);
                 cursor->column = line->length;
                 return;
         }
         
-        line = EditBuffer_Cursor_getCurrentLine(cursor);
+        line = EditBuffer_peekLine(cursor->parent, cursor->row);
 
         if (cursor->column > line->length) {
                 cursor->column = line->length;
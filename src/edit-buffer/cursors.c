@@ -0,0 +1,486 @@
+#include "module.h"
+
+static int    EditBuffer_comparePositions (size_t, size_t, size_t, size_t);
+static size_t EditBuffer_findCursor       (EditBuffer *, size_t, size_t);
+static void   EditBuffer_sortCursors      (EditBuffer *);
+static void   EditBuffer_catchUpCursor    (EditBuffer *, EditBuffer_Cursor *);
+static void   EditBuffer_catchUpCursors   (EditBuffer *);
+
+static void EditBuffer_Edit_apply  (EditBuffer_Edit *,  size_t *, size_t *);
+static int  EditBuffer_Shift_fold  (EditBuffer_Shift *, EditBuffer_Edit *);
+static int  EditBuffer_Shift_apply (EditBuffer_Shift *, size_t *, size_t *);
+
+/* EditBuffer_clearExtraCursors
+ * Remove all cursors except the primary one.
+ */
+void EditBuffer_clearExtraCursors (EditBuffer *editBuffer) {
+        editBuffer->cursors[0] =
+                editBuffer->cursors[editBuffer->primaryCursor];
+        editBuffer->amountOfCursors = 1;
+        editBuffer->primaryCursor   = 0;
+}
+
+/* EditBuffer_addNewCursor
+ * Adds a new cursor at the specified row and column, unless there is already a
+ * cursor there.
+ */
+void EditBuffer_addNewCursor (
+        EditBuffer *editBuffer,
+        size_t column,
+        size_t row
+) {
+        size_t place = EditBuffer_findCursor(editBuffer, column, row);
+        if (place < editBuffer->amountOfCursors) {
+                EditBuffer_Cursor *cursor = &editBuffer->cursors[place];
+                if (cursor->column == column && cursor->row == row) { return; }
+        }
+
+        if (editBuffer->amountOfCursors >= editBuffer->cursorsSize) {
+                editBuffer->cursorsSize = MAX(editBuffer->cursorsSize * 2, 8);
+                editBuffer->cursors = realloc (
+                        editBuffer->cursors,
+                        editBuffer->cursorsSize * sizeof(EditBuffer_Cursor));
+        }
+
+        memmove (
+                editBuffer->cursors + place + 1,
+                editBuffer->cursors + place,
+                (editBuffer->amountOfCursors - place) *
+                        sizeof(EditBuffer_Cursor));
+        editBuffer->amountOfCursors ++;
+
+        if (
+                editBuffer->amountOfCursors > 1 &&
+                editBuffer->primaryCursor >= place
+        ) {
+                editBuffer->primaryCursor ++;
+        }
+
+        EditBuffer_Cursor *newCursor = &editBuffer->cursors[place];
+        *newCursor = (const EditBuffer_Cursor) { 0 };
+
+        newCursor->parent     = editBuffer;
+        newCursor->column     = column;
+        newCursor->row        = row;
+        newCursor->batchEdits = editBuffer->amountOfEdits;
+
+        EditBuffer_Cursor_selectNone(newCursor);
+}
+
+/* EditBuffer_getPrimaryCursor
+ * Returns the primary cursor. The pointer is only valid until the cursors are
+ * next moved, added, or removed.
+ */
+EditBuffer_Cursor *EditBuffer_getPrimaryCursor (EditBuffer *editBuffer) {
+        return &editBuffer->cursors[editBuffer->primaryCursor];
+}
+
+/* EditBuffer_hasCursorAt
+ * Returns 1 if there is a cursor at the specified coordinates, otherwise
+ * returns zero.
+ */
+int EditBuffer_hasCursorAt (EditBuffer *editBuffer, size_t column, size_t row) {
+        for (
+                size_t index = EditBuffer_findCursor(editBuffer, column, row);
+                index < editBuffer->amountOfCursors;
+                index ++
+        ) {
+                EditBuffer_Cursor *cursor = &editBuffer->cursors[index];
+                if (cursor->column != column || cursor->row != row) { break; }
+                if (!cursor->hasSelection) { return 1; }
+        }
+
+        return 0;
+}
+
+/* EditBuffer_hasSelectionAt
+ * Returns 1 if there is a selection at the specified coordinates, otherwise
+ * returns zero.
+ */
+int EditBuffer_hasSelectionAt (
+        EditBuffer *editBuffer,
+        size_t column,
+        size_t row
+) {
+        START_ALL_CURSORS
+                if (!cursor->hasSelection) { continue; }
+
+                // sort selection start and end
+                size_t startColumn;
+                size_t startRow;
+                size_t endColumn;
+                size_t endRow;
+
+                EditBuffer_Cursor_getSelectionBounds (
+                        cursor,
+                        &startColumn, &startRow,
+                        &endColumn,   &endRow);
+
+                // go on to the next cursor if the input is out of bounds of
+                // this one
+                if (row < startRow  || endRow < row)          { continue; }
+                if (row == startRow && column < startColumn ) { continue; }
+                if (row == endRow   && column > endColumn )   { continue; }
+
+                return 1;
+        END_ALL_CURSORS
+        return 0;
+}
+
+/* EditBuffer_shiftCursors
+ * Moves cursors along with the text around them after an edit. During a batch
+ * operation, only the cursor doing the operation is moved right away, and the
+ * edit is recorded so the rest can be moved when the operation is over.
+ */
+void EditBuffer_shiftCursors (EditBuffer *editBuffer, EditBuffer_Edit *edit) {
+        if (!editBuffer->batching) {
+                START_ALL_CURSORS
+                        EditBuffer_Edit_apply (
+                                edit,
+                                &cursor->column, &cursor->row);
+                        EditBuffer_Edit_apply (
+                                edit,
+                                &cursor->selectionColumn,
+                                &cursor->selectionRow);
+                END_ALL_CURSORS
+                return;
+        }
+
+        if (editBuffer->amountOfEdits >= editBuffer->editsSize) {
+                editBuffer->editsSize = MAX(editBuffer->editsSize * 2, 16);
+                editBuffer->edits = realloc (
+                        editBuffer->edits,
+                        editBuffer->editsSize * sizeof(EditBuffer_Edit));
+        }
+        editBuffer->edits[editBuffer->amountOfEdits] = *edit;
+        editBuffer->amountOfEdits ++;
+
+        if (EditBuffer_comparePositions (
+                edit->startColumn,            edit->startRow,
+                editBuffer->editsStartColumn, editBuffer->editsStartRow
+        ) < 0) {
+                editBuffer->editsStartColumn = edit->startColumn;
+                editBuffer->editsStartRow    = edit->startRow;
+        }
+
+        EditBuffer_catchUpCursor(editBuffer, editBuffer->batchCursor);
+}
+
+/* EditBuffer_startBatch
+ * Starts an operation on all cursors. The cursors are gone through from last to
+ * first using EditBuffer_startBatchCursor, so that edits made by one cursor
+ * never move the cursors that have not had their turn yet, unless their
+ * selections overlap.
+ */
+void EditBuffer_startBatch (EditBuffer *editBuffer) {
+        editBuffer->batching         = 1;
+        editBuffer->amountOfEdits    = 0;
+        editBuffer->editsStartColumn = SIZE_MAX;
+        editBuffer->editsStartRow    = SIZE_MAX;
+
+        // everything done during the batch is undone all at once
+        editBuffer->history.grouping     = 1;
+        editBuffer->history.groupStarted = 0;
+
+        START_ALL_CURSORS
+                cursor->batchEdits = 0;
+        END_ALL_CURSORS
+}
+
+/* EditBuffer_startBatchCursor
+ * Returns the cursor at index, ready to have the current batch operation done
+ * on it.
+ */
+EditBuffer_Cursor *EditBuffer_startBatchCursor (
+        EditBuffer *editBuffer,
+        size_t index
+) {
+        EditBuffer_Cursor *cursor = &editBuffer->cursors[index];
+        editBuffer->batchCursor = cursor;
+
+        // edits only ever move text at or after where they start, so unless
+        // this cursor reaches back into one of them, none of them moved it.
+        size_t startColumn = editBuffer->editsStartColumn;
+        size_t startRow    = editBuffer->editsStartRow;
+        if (
+                EditBuffer_comparePositions (
+                        cursor->column, cursor->row,
+                        startColumn,    startRow) < 0 &&
+                EditBuffer_comparePositions (
+                        cursor->selectionColumn, cursor->selectionRow,
+                        startColumn,             startRow) < 0
+        ) {
+                cursor->batchEdits = editBuffer->amountOfEdits;
+        } else {
+                EditBuffer_catchUpCursor(editBuffer, cursor);
+        }
+
+        return cursor;
+}
+
+/* EditBuffer_endBatch
+ * Finishes an operation on all cursors. Every cursor is moved along with the
+ * edits made after its turn, and then the cursors are merged.
+ */
+void EditBuffer_endBatch (EditBuffer *editBuffer) {
+        EditBuffer_catchUpCursors(editBuffer);
+
+        editBuffer->batching      = 0;
+        editBuffer->batchCursor   = NULL;
+        editBuffer->amountOfEdits = 0;
+        editBuffer->history.grouping = 0;
+
+        EditBuffer_mergeCursors(editBuffer);
+}
+
+/* EditBuffer_mergeCursors
+ * Puts the cursors back in order, and removes redundant, overlapping cursors.
+ * This should be called whenever a cursor moves. Cursors are almost always
+ * still in order or close to it, so this is usually one pass over them.
+ */
+void EditBuffer_mergeCursors (EditBuffer *editBuffer) {
+        // if we are currently looping over all cursors, don't merge yet
+        if (editBuffer->batching) { return; }
+
+        EditBuffer_sortCursors(editBuffer);
+
+        EditBuffer_Cursor *cursors = editBuffer->cursors;
+        size_t kept = 0;
+        for (size_t index = 1; index < editBuffer->amountOfCursors; index ++) {
+                if (
+                        cursors[index].column == cursors[kept].column &&
+                        cursors[index].row    == cursors[kept].row
+                ) {
+                        // never get rid of the primary cursor
+                        if (editBuffer->primaryCursor == index) {
+                                cursors[kept] = cursors[index];
+                                editBuffer->primaryCursor = kept;
+                        }
+                        continue;
+                }
+
+                kept ++;
+                cursors[kept] = cursors[index];
+                if (editBuffer->primaryCursor == index) {
+                        editBuffer->primaryCursor = kept;
+                }
+        }
+
+        if (editBuffer->amountOfCursors > 0) {
+                editBuffer->amountOfCursors = kept + 1;
+        }
+}
+
+/* EditBuffer_comparePositions
+ * Returns a negative number if the first position comes before the second one,
+ * zero if they are the same, and a positive number if it comes after.
+ */
+static int EditBuffer_comparePositions (
+        size_t columnA, size_t rowA,
+        size_t columnB, size_t rowB
+) {
+        if (rowA    != rowB)    { return rowA    < rowB    ? -1 : 1; }
+        if (columnA != columnB) { return columnA < columnB ? -1 : 1; }
+        return 0;
+}
+
+/* EditBuffer_findCursor
+ * Returns the index of the first cursor that is not positioned before the
+ * specified column and row.
+ */
+static size_t EditBuffer_findCursor (
+        EditBuffer *editBuffer,
+        size_t column, size_t row
+) {
+        size_t low  = 0;
+        size_t high = editBuffer->amountOfCursors;
+        while (low < high) {
+                size_t middle = low + (high - low) / 2;
+                EditBuffer_Cursor *cursor = &editBuffer->cursors[middle];
+                if (EditBuffer_comparePositions (
+                        cursor->column, cursor->row,
+                        column,         row
+                ) < 0) {
+                        low = middle + 1;
+                } else {
+                        high = middle;
+                }
+        }
+        return low;
+}
+
+/* EditBuffer_sortCursors
+ * Sorts the cursors by position, keeping track of the primary cursor. This is
+ * an insertion sort, since cursors that move generally don't pass each other.
+ */
+static void EditBuffer_sortCursors (EditBuffer *editBuffer) {
+        EditBuffer_Cursor *cursors = editBuffer->cursors;
+
+        for (size_t index = 1; index < editBuffer->amountOfCursors; index ++) {
+                EditBuffer_Cursor cursor = cursors[index];
+                int isPrimary = editBuffer->primaryCursor == index;
+
+                size_t place = index;
+                while (place > 0 && EditBuffer_comparePositions (
+                        cursor.column,              cursor.row,
+                        cursors[place - 1].column, cursors[place - 1].row
+                ) < 0) {
+                        cursors[place] = cursors[place - 1];
+                        if (editBuffer->primaryCursor == place - 1) {
+                                editBuffer->primaryCursor = place;
+                        }
+                        place --;
+                }
+
+                cursors[place] = cursor;
+                if (isPrimary) { editBuffer->primaryCursor = place; }
+        }
+}
+
+/* EditBuffer_catchUpCursor
+ * Moves a cursor along with every edit recorded in the current batch operation
+ * that it has not been moved along with yet, one by one.
+ */
+static void EditBuffer_catchUpCursor (
+        EditBuffer *editBuffer,
+        EditBuffer_Cursor *cursor
+) {
+        for (
+                size_t index = cursor->batchEdits;
+                index < editBuffer->amountOfEdits;
+                index ++
+        ) {
+                EditBuffer_Edit *edit = &editBuffer->edits[index];
+                EditBuffer_Edit_apply(edit, &cursor->column, &cursor->row);
+                EditBuffer_Edit_apply (
+                        edit,
+                        &cursor->selectionColumn, &cursor->selectionRow);
+        }
+        cursor->batchEdits = editBuffer->amountOfEdits;
+}
+
+/* EditBuffer_catchUpCursors
+ * Moves every cursor along with the edits recorded in the current batch
+ * operation after its turn. Each cursor needs the edits made by all cursors
+ * before it, which all lie before it in the text, so they only ever shift it.
+ * Going through the cursors in order, those edits are folded into one shift
+ * as we go, making this a single pass over the cursors and edits.
+ */
+static void EditBuffer_catchUpCursors (EditBuffer *editBuffer) {
+        if (editBuffer->amountOfEdits == 0) { return; }
+
+        EditBuffer_Shift shift  = { 0 };
+        size_t           folded = editBuffer->amountOfEdits;
+        int              valid  = 1;
+
+        START_ALL_CURSORS
+                while (valid && folded > cursor->batchEdits) {
+                        folded --;
+                        valid = EditBuffer_Shift_fold (
+                                &shift,
+                                &editBuffer->edits[folded]);
+                }
+
+                // cursors whose selections reach back over other cursors
+                // need to be moved along with each edit separately
+                size_t column          = cursor->column;
+                size_t row             = cursor->row;
+                size_t selectionColumn = cursor->selectionColumn;
+                size_t selectionRow    = cursor->selectionRow;
+                if (
+                        !valid || folded != cursor->batchEdits ||
+                        !EditBuffer_Shift_apply(&shift, &column, &row) ||
+                        !EditBuffer_Shift_apply (
+                                &shift,
+                                &selectionColumn, &selectionRow)
+                ) {
+                        EditBuffer_catchUpCursor(editBuffer, cursor);
+                        continue;
+                }
+
+                cursor->column          = column;
+                cursor->row             = row;
+                cursor->selectionColumn = selectionColumn;
+                cursor->selectionRow    = selectionRow;
+                cursor->batchEdits      = editBuffer->amountOfEdits;
+        END_ALL_CURSORS
+}
+
+/* EditBuffer_Edit_apply
+ * Moves a position along with the text around it after an edit. Positions
+ * before the edit stay put, positions inside of text that was replaced go to
+ * the start of the edit, and positions after the edit are shifted.
+ */
+static void EditBuffer_Edit_apply (
+        EditBuffer_Edit *edit,
+        size_t *column, size_t *row
+) {
+        if (EditBuffer_comparePositions (
+                *column,           *row,
+                edit->startColumn, edit->startRow
+        ) < 0) {
+                return;
+        }
+
+        if (EditBuffer_comparePositions (
+                *column,            *row,
+                edit->oldEndColumn, edit->oldEndRow
+        ) < 0) {
+                *column = edit->startColumn;
+                *row    = edit->startRow;
+                return;
+        }
+
+        if (*row == edit->oldEndRow) {
+                *column = *column - edit->oldEndColumn + edit->newEndColumn;
+        }
+        *row = *row - edit->oldEndRow + edit->newEndRow;
+}
+
+/* EditBuffer_Shift_fold
+ * Changes shift so that it first moves positions along with edit, and then does
+ * what it did before. This only works if everything after the edit is also
+ * after the shift, and if not, this function returns zero.
+ */
+static int EditBuffer_Shift_fold (
+        EditBuffer_Shift *shift,
+        EditBuffer_Edit *edit
+) {
+        if (EditBuffer_comparePositions (
+                edit->newEndColumn, edit->newEndRow,
+                shift->column,      shift->row
+        ) < 0) {
+                return 0;
+        }
+
+        // the sizes wrap around when the shift moves things backwards, but
+        // they are only ever added to positions that end up in bounds.
+        size_t columns = edit->newEndColumn - edit->oldEndColumn;
+        if (edit->newEndRow == shift->row) { columns += shift->columns; }
+
+        shift->rows    = edit->newEndRow - edit->oldEndRow + shift->rows;
+        shift->columns = columns;
+        shift->column  = edit->oldEndColumn;
+        shift->row     = edit->oldEndRow;
+        return 1;
+}
+
+/* EditBuffer_Shift_apply
+ * Shifts a position. If the position comes before where the shift starts, it
+ * is left alone and this function returns zero.
+ */
+static int EditBuffer_Shift_apply (
+        EditBuffer_Shift *shift,
+        size_t *column, size_t *row
+) {
+        if (EditBuffer_comparePositions (
+                *column,       *row,
+                shift->column, shift->row
+        ) < 0) {
+                return 0;
+        }
+
+        if (*row == shift->row) { *column += shift->columns; }
+        *row += shift->rows;
+        return 1;
+}
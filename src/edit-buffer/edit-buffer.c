@@ -1,11 +1,23 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
 #include "module.h"
 #include "options.h"
 
+static Error EditBuffer_openFile (EditBuffer *, const char *, int, int);
+
+static void (*onWorkerFinish) (void) = NULL;
+
 /* EditBuffer_new
  * Creates and initializes a new edit buffer.
  */
 EditBuffer *EditBuffer_new (void) {
         EditBuffer *editBuffer = calloc(1, sizeof(EditBuffer));
+        editBuffer->journal.file = -1;
+        editBuffer->load.file    = -1;
+        editBuffer->follow.watch = -1;
+        editBuffer->follow.file  = -1;
         EditBuffer_reset(editBuffer);
         return editBuffer;
 }
@@ -15,44 +27,112 @@ EditBuffer *EditBuffer_new (void) {
  */
 void EditBuffer_free (EditBuffer *editBuffer) {
         EditBuffer_reset(editBuffer);
+        free(editBuffer->cursors);
+        free(editBuffer->edits);
         free(editBuffer);
 }
 
+/* EditBuffer_onWorkerFinish
+ * Sets the function to be called whenever a worker thread of any buffer is done
+ * loading or saving. It is called on the worker thread, so it has to be safe to
+ * call from any thread. It should get the main thread to check on the buffers,
+ * since EditBuffer_finishLoad and EditBuffer_finishSave won't block anymore.
+ */
+void EditBuffer_onWorkerFinish (void (*callback) (void)) {
+        onWorkerFinish = callback;
+}
+
+/* EditBuffer_notifyWorkerFinish
+ * Lets whoever is listening know that a worker thread is done. This is called
+ * by the worker thread itself, right before it ends.
+ */
+void EditBuffer_notifyWorkerFinish (void) {
+        if (onWorkerFinish != NULL) { onWorkerFinish(); }
+}
+
 /* EditBuffer_open
  * Loads a file into an edit buffer. This resets the buffer first. If filePath
  * is NULL, or the operation fails, the buffer will just have one (blank) line.
+ * Files at least Options_readOnlySize bytes big are opened read only.
  */
 Error EditBuffer_open (EditBuffer *editBuffer, const char *filePath) {
+        return EditBuffer_openFile(editBuffer, filePath, 0, 0);
+}
+
+/* EditBuffer_openReadOnly
+ * Loads a file into an edit buffer so that it can only be viewed. No matter how
+ * big the file is, only a small index of where its lines start is kept in
+ * memory, and lines are only decoded when they are looked at.
+ */
+Error EditBuffer_openReadOnly (EditBuffer *editBuffer, const char *filePath) {
+        return EditBuffer_openFile(editBuffer, filePath, 1, 0);
+}
+
+/* EditBuffer_openFollowing
+ * Loads a file into an edit buffer as read only, and then follows it as it
+ * grows, like a log file that is still being written to. Whatever is written
+ * onto the end of the file is added onto the end of the buffer by
+ * EditBuffer_updateFollow.
+ */
+Error EditBuffer_openFollowing (EditBuffer *editBuffer, const char *filePath) {
+        return EditBuffer_openFile(editBuffer, filePath, 1, 1);
+}
+
+/* EditBuffer_openFile
+ * Loads a file into an edit buffer, optionally as read only, and optionally
+ * following it. See EditBuffer_open.
+ */
+static Error EditBuffer_openFile (
+        EditBuffer *editBuffer,
+        const char *filePath,
+        int        readOnly,
+        int        follow
+) {
         EditBuffer_reset(editBuffer);
         Utility_copyCString(editBuffer->filePath, filePath, PATH_MAX);
 
-        String *line = String_new("");
-        EditBuffer_placeLine (
-                editBuffer, line,
-                editBuffer->length);
-        
-        if (filePath == NULL) { return Error_none; }
-
-        FILE *file = fopen(filePath, "r");
-        if (file == NULL) { return Error_cantOpenFile; }
-
-        int reachedEnd = 0;
-        while (!reachedEnd) {
-                Rune rune = Unicode_utf8FileGetRune(file, &reachedEnd);
-                if (rune == 0) { continue; }
-                
-                if (rune == '\n') {
-                        line = String_new("");
-                        EditBuffer_placeLine (
-                                editBuffer, line,
-                                editBuffer->length);
-                } else {
-                        String_addRune(line, rune);
-                }
+        int file = -1;
+        if (filePath != NULL) { file = open(filePath, O_RDONLY); }
+
+        if (file < 0) {
+                EditBuffer_placeLine(editBuffer, String_new(""), 0);
+                if (filePath == NULL) { return Error_none; }
+
+                // there might be unsaved work for a file that was never made
+                if (!readOnly) { EditBuffer_openJournal(editBuffer, -1); }
+                return Error_cantOpenFile;
+        }
+
+        struct stat info;
+        if (
+                fstat(file, &info) == 0 &&
+                (size_t)(info.st_size) >= Options_readOnlySize
+        ) {
+                readOnly = 1;
         }
 
-        fclose(file);
-        return Error_cantOpenFile;
+        // the file of a followed buffer is kept open to read from as it grows
+        editBuffer->readOnly = readOnly;
+        if (follow) { editBuffer->follow.file = file; }
+        EditBuffer_loadOriginal(editBuffer, file);
+        if (follow) { return EditBuffer_startFollow(editBuffer); }
+        if (readOnly) {
+                close(file);
+                return Error_none;
+        }
+
+        // unsaved work in the journal can only be put back once the whole
+        // file is there, so the file is kept open until it is. if that is
+        // right away, nobody has placed the cursor yet, so it starts at the
+        // top no matter what was recovered.
+        editBuffer->load.file = file;
+        if (!editBuffer->load.running) {
+                EditBuffer_finishLoad(editBuffer);
+                EditBuffer_Cursor_moveTo (
+                        EditBuffer_getPrimaryCursor(editBuffer),
+                        0, 0);
+        }
+        return Error_none;
 }
 
 /* EditBuffer_copy
@@ -61,18 +141,14 @@ Error EditBuffer_open (EditBuffer *editBuffer, const char *filePath) {
 void EditBuffer_copy (EditBuffer *editBuffer, const char *buffer) {
         EditBuffer_reset(editBuffer);
 
-        String *line = String_new("");
-        char ch;
-        for (size_t index = 0; (ch = buffer[index]); index ++) {
-                if (ch == '\n') {
-                        EditBuffer_placeLine (
-                                editBuffer, line,
-                                editBuffer->length);
-                        line = String_new("");
-                } else {
-                        // TODO: fix this!
-                        String_addRune(line, (Rune)ch);
-                }
+        const char *lineStart = buffer;
+        for (const char *ch = buffer; *ch; ch ++) {
+                if (*ch != '\n') { continue; }
+
+                String *line = String_new("");
+                String_addBytes(line, lineStart, (size_t)(ch - lineStart));
+                EditBuffer_placeLine(editBuffer, line, editBuffer->length);
+                lineStart = ch + 1;
         }
 }
 
@@ -82,104 +158,72 @@ void EditBuffer_copy (EditBuffer *editBuffer, const char *buffer) {
  * entered in.
  */
 void EditBuffer_reset (EditBuffer *editBuffer) {
-        for (size_t index = 0; index < editBuffer->length; index ++) {
-                String_free(editBuffer->lines[index]);
-        }
-
-        free(editBuffer->lines);
+        // a load or a save in progress might still be reading the original
+        // file buffer
+        EditBuffer_stopLoad(editBuffer);
+        EditBuffer_stopFollow(editBuffer);
+        EditBuffer_closeJournal(editBuffer);
+        EditBuffer_finishSave(editBuffer);
+        EditBuffer_Original_free(&editBuffer->save.saved);
+        EditBuffer_freePieces(editBuffer);
+        EditBuffer_freeHistory(editBuffer);
+        free(editBuffer->cursors);
+        free(editBuffer->edits);
 
         *editBuffer = (const EditBuffer) { 0 };
+        editBuffer->journal.file = -1;
+        editBuffer->load.file    = -1;
+        editBuffer->follow.watch = -1;
+        editBuffer->follow.file  = -1;
         EditBuffer_addNewCursor(editBuffer, 0, 0);
+
+        editBuffer->changes.changed = 1;
+        editBuffer->changes.all     = 1;
 }
 
-/* EditBuffer_clearExtraCursors
- * Remove all cursors except the original one.
+/* EditBuffer_takeChanges
+ * Stores the changes made to the lines of the buffer since this function was
+ * last called in changes, and then forgets about them.
  */
-void EditBuffer_clearExtraCursors (EditBuffer *editBuffer) {
-        editBuffer->amountOfCursors = 1;
+void EditBuffer_takeChanges (
+        EditBuffer         *editBuffer,
+        EditBuffer_Changes *changes
+) {
+        *changes = editBuffer->changes;
+        editBuffer->changes = (const EditBuffer_Changes) { 0 };
 }
 
-/* EditBuffer_addNewCursor
- * Adds a new cursor at the specified row and column.
+/* EditBuffer_markChanged
+ * Records that the lines from start to oldEnd were replaced by the lines from
+ * start to newEnd. This is merged with any changes that haven't been taken yet,
+ * so the result might cover more lines than actually changed, but never less.
  */
-void EditBuffer_addNewCursor (
+void EditBuffer_markChanged (
         EditBuffer *editBuffer,
-        size_t column,
-        size_t row
+        size_t start,
+        size_t oldEnd,
+        size_t newEnd
 ) {
-        // don't add a new cursor if we are at the max
-        if (editBuffer->amountOfCursors >= EDITBUFFER_MAX_CURSORS - 1) {
+        EditBuffer_Changes *changes = &editBuffer->changes;
+
+        if (!changes->changed) {
+                changes->changed = 1;
+                changes->start   = start;
+                changes->oldEnd  = oldEnd;
+                changes->newEnd  = newEnd;
                 return;
         }
 
-        // don't add if there is already a cursor in that spot
-        START_ALL_CURSORS
-                if (cursor->column == column && cursor->row == row) {
-                        return;
-                }
-        END_ALL_CURSORS
-
-        EditBuffer_Cursor *newCursor =
-                &editBuffer->cursors[editBuffer->amountOfCursors];
-        
-        newCursor->parent = editBuffer;
-        newCursor->column = column;
-        newCursor->row    = row;
-
-        EditBuffer_Cursor_selectNone(newCursor);
-        editBuffer->amountOfCursors ++;
-}
-
-/* EditBuffer_hasCursorAt
- * Returns 1 if there is a cursor at the specified coordinates, otherwise
- * returns zero.
- */
-int EditBuffer_hasCursorAt (EditBuffer *editBuffer, size_t column, size_t row) {
-        START_ALL_CURSORS
-                if (
-                        !cursor->hasSelection    &&
-                        cursor->column == column &&
-                        cursor->row    == row
-                ) {
-                        return 1;
-                }
-        END_ALL_CURSORS
-
-        return 0;
-}
+        // the new change is in terms of the lines as they are now, so its end
+        // needs to be mapped back to where those lines originally were
+        if (oldEnd > changes->newEnd) {
+                changes->oldEnd += oldEnd - changes->newEnd;
+                changes->newEnd  = newEnd;
+        } else {
+                changes->newEnd = changes->newEnd - oldEnd + newEnd;
+        }
 
-/* EditBuffer_hasSelectionAt
- * Returns 1 if there is a selection at the specified coordinates, otherwise
- * returns zero.
- */
-int EditBuffer_hasSelectionAt (
-        EditBuffer *editBuffer,
-        size_t column,
-        size_t row
-) {
-        START_ALL_CURSORS
-                if (!cursor->hasSelection) { continue; }
-
-                // sort selection start and end
-                size_t startColumn;
-                size_t startRow;
-                size_t endColumn;
-                size_t endRow;
-
-                EditBuffer_Cursor_getSelectionBounds (
-                        cursor,
-                        &startColumn, &startRow,
-                        &endColumn,   &endRow);
-
-                // go on to the next cursor if the input is out of bounds of
-                // this one
-                if (row < startRow  || endRow < row)          { continue; }
-                if (row == startRow && column < startColumn ) { continue; }
-                if (row == endRow   && column > endColumn )   { continue; }
-                               
-                return 1;
-        END_ALL_CURSORS
-        return 0;
+        changes->start = MIN(changes->start, start);
 }
 
 /* EditBuffer_insertRuneAt
@@ -200,73 +244,15 @@ void EditBuffer_insertRuneAt (
                 String_splitInto(currentLine, newLine, column);
                 EditBuffer_placeLine(editBuffer, newLine, row + 1);
 
-                // TODO: possibly combine these two into one loop
-                
-                // shift down cursors after the new line break
-                START_ALL_CURSORS
-                        if (cursor->row < row) {
-                                // this cursor comes before the insertion
-                                continue;
-                        }
-
-                        if (cursor->row > row) {
-                                // this cursor is in a row after the insertion,
-                                // so it simply needs to be shifted down.
-                                cursor->row ++;
-                                continue;
-                        }
-
-                        // these are on the same column as the insertion
-
-                        if (cursor->column < column) {
-                                // this cursor comes before the insertion
-                                continue;
-                        }
-                
-                        if (cursor->column == column) {
-                                // this is the cursor that caused the
-                                // insertion, so it should wrap around
-                                // to the beginning of the next line
-                                cursor->column = 0;
-                                cursor->row ++;
-                                continue;
-                        }
-                
-                        if (cursor->column > column) {
-                                // this cursor was previously on the
-                                // part of the line that got split and
-                                // made into its own line. it needs to
-                                // have its position set to the proper
-                                // place on that new line.
-                                cursor->column -= currentLine->length;
-                                cursor->row ++;
-                                continue;
-                        }
-                END_ALL_CURSORS
-
-                // the same thing, but for the selection coordinates
-                START_ALL_CURSORS
-                        if (cursor->selectionRow < row) {  continue; }
-
-                        if (cursor->selectionRow > row) {
-                                cursor->selectionRow ++;
-                                continue;
-                        }
-
-                        if (cursor->selectionColumn < column) { continue; }
-                
-                        if (cursor->selectionColumn == column) {
-                                cursor->selectionColumn = 0;
-                                cursor->selectionRow ++;
-                                continue;
-                        }
-                
-                        if (cursor->selectionColumn > column) {
-                                cursor->selectionColumn -= currentLine->length;
-                                cursor->selectionRow ++;
-                                continue;
-                        }
-                END_ALL_CURSORS
+                // the cursor that caused the insertion wraps around to the
+                // beginning of the new line, along with everything after it
+                EditBuffer_Edit edit = {
+                        .startColumn  = column, .startRow  = row,
+                        .oldEndColumn = column, .oldEndRow = row,
+                        .newEndColumn = 0,      .newEndRow = row + 1,
+                };
+                EditBuffer_recordInsertion(editBuffer, &edit);
+                EditBuffer_shiftCursors(editBuffer, &edit);
                 return;
         }
 
@@ -281,16 +267,97 @@ void EditBuffer_insertRuneAt (
                         String_insertRune(currentLine, ' ', column);
                 }
 
-                EditBuffer_shiftCursorsInLineAfter (
-                        editBuffer,
-                        column, row,
-                        (int)(spacesNeeded));
+                EditBuffer_Edit edit = {
+                        .startColumn  = column, .startRow  = row,
+                        .oldEndColumn = column, .oldEndRow = row,
+                        .newEndColumn = column + spacesNeeded,
+                        .newEndRow    = row,
+                };
+                EditBuffer_recordInsertion(editBuffer, &edit);
+                EditBuffer_shiftCursors(editBuffer, &edit);
                 return;
         }
 
         // This is just a normal rune insertion
         String_insertRune(currentLine, rune, column);
-        EditBuffer_shiftCursorsInLineAfter(editBuffer, column, row, 1);
+        EditBuffer_Edit edit = {
+                .startColumn  = column,     .startRow  = row,
+                .oldEndColumn = column,     .oldEndRow = row,
+                .newEndColumn = column + 1, .newEndRow = row,
+        };
+        EditBuffer_recordInsertion(editBuffer, &edit);
+        EditBuffer_shiftCursors(editBuffer, &edit);
+}
+
+/* EditBuffer_insertStringAt
+ * Inserts a string at a specific column and row. Unlike
+ * EditBuffer_insertRuneAt, the text is inserted as is, so tabs are never turned
+ * into spaces. The string is split into lines all at once, and any new lines
+ * are spliced into the buffer together.
+ */
+void EditBuffer_insertStringAt (
+        EditBuffer *editBuffer,
+        size_t column, size_t row,
+        String *string
+) {
+        String *currentLine = EditBuffer_getLine(editBuffer, row);
+
+        const char *buffer  = string->buffer;
+        const char *newline = memchr(buffer, '\n', string->byteLength);
+        if (newline == NULL) {
+                String_insertString(currentLine, string, column);
+                EditBuffer_Edit edit = {
+                        .startColumn  = column, .startRow  = row,
+                        .oldEndColumn = column, .oldEndRow = row,
+                        .newEndColumn = column + string->length,
+                        .newEndRow    = row,
+                };
+                EditBuffer_recordInsertion(editBuffer, &edit);
+                EditBuffer_shiftCursors(editBuffer, &edit);
+                return;
+        }
+
+        // the rest of the current line goes after the inserted text
+        String *rest = String_new("");
+        String_splitInto(currentLine, rest, column);
+        String_addByteRange(currentLine, string, 0, (size_t)(newline - buffer));
+
+        String **lines = NULL;
+        size_t amountOfLines = 0;
+        size_t linesSize     = 0;
+        while (newline != NULL) {
+                size_t start = (size_t)(newline - buffer) + 1;
+                newline = memchr (
+                        buffer + start, '\n',
+                        string->byteLength - start);
+                size_t end = string->byteLength;
+                if (newline != NULL) { end = (size_t)(newline - buffer); }
+
+                if (amountOfLines >= linesSize) {
+                        linesSize = MAX(linesSize * 2, 16);
+                        lines = realloc(lines, linesSize * sizeof(String *));
+                }
+
+                String *line = String_new("");
+                String_addByteRange(line, string, start, end);
+                lines[amountOfLines ++] = line;
+        }
+
+        String *lastLine   = lines[amountOfLines - 1];
+        size_t  lastColumn = lastLine->length;
+        String_addString(lastLine, rest);
+        String_free(rest);
+
+        EditBuffer_placeLines(editBuffer, lines, amountOfLines, row + 1);
+        free(lines);
+
+        EditBuffer_Edit edit = {
+                .startColumn  = column,     .startRow  = row,
+                .oldEndColumn = column,     .oldEndRow = row,
+                .newEndColumn = lastColumn, .newEndRow = row + amountOfLines,
+        };
+        EditBuffer_recordInsertion(editBuffer, &edit);
+        EditBuffer_shiftCursors(editBuffer, &edit);
 }
 
 /* EditBuffer_deleteRuneAt
@@ -306,187 +373,132 @@ void EditBuffer_deleteRuneAt (
         
         // if we are within a line, we can just delete the rune we are on
         if (column < currentLine->length) {
+                EditBuffer_Edit edit = {
+                        .startColumn  = column,     .startRow  = row,
+                        .oldEndColumn = column + 1, .oldEndRow = row,
+                        .newEndColumn = column,     .newEndRow = row,
+                };
+                EditBuffer_recordDeletion(editBuffer, &edit);
                 String_deleteRune(currentLine, column);
-                EditBuffer_shiftCursorsInLineAfter (
-                        editBuffer,
-                        column + 1, row,
-                        -1);
+                EditBuffer_shiftCursors(editBuffer, &edit);
                 return;
         }
 
         // cannot combine a line below
         if (row >= editBuffer->length - 1) { return; }
 
-        // lift next line out and combine it with this one
+        // cursors on the line that gets merged in are shifted over to the
+        // right, after the text that was already there
         size_t previousLength = currentLine->length;
+        EditBuffer_Edit edit = {
+                .startColumn  = previousLength, .startRow  = row,
+                .oldEndColumn = 0,              .oldEndRow = row + 1,
+                .newEndColumn = previousLength, .newEndRow = row,
+        };
+        EditBuffer_recordDeletion(editBuffer, &edit);
+
+        // lift next line out and combine it with this one
         String *nextLine = EditBuffer_getLine(editBuffer, row + 1);
         String_addString(currentLine, nextLine);
-        EditBuffer_shiftUp(editBuffer, row + 1, 1, 0);
-
-        START_ALL_CURSORS
-                // shift up cursors under the current line
-                if (cursor->row > row) {
-                        cursor->row --;
-                        if (cursor->row == row) {
-                                // if the cursor was on a line that got merged
-                                // in, we need to shift the position over to the
-                                // right after it gets shifted up.
-                                cursor->column += previousLength;
-                        }
-
-                }
-
-                // do the same thing with the selection end
-                if (cursor->selectionRow > row) {
-                        cursor->selectionRow --;
-                        if (cursor->selectionRow == row) {
-                                cursor->selectionColumn += previousLength;
-                        }
-                }
-        END_ALL_CURSORS
-
-        // since we deleted a line, there might be cursors that are now out of
-        // bounds, and we need to bring them back in.
-        EditBuffer_cursorsWrangle(editBuffer);
+        EditBuffer_removeLines(editBuffer, row + 1, 1);
+        EditBuffer_shiftCursors(editBuffer, &edit);
 }
 
 /* EditBuffer_deleteRange
- * Deletes all runes in the specified range, inclusive.
+ * Deletes all runes in the specified range, inclusive. A column one past the
+ * end of a line stands for the line break after it. The lines in between are
+ * spliced out all at once, and what is left of the end line is joined onto the
+ * start line in one copy.
  */
 void  EditBuffer_deleteRange (
         EditBuffer *editBuffer,
         size_t startColumn, size_t startRow,
         size_t endColumn,   size_t endRow
 ) {
-        size_t numberOfLines = endRow - startRow + 1;
-        
-        if (numberOfLines >= 3) {
-                // there are lines in the middle we can quickly deal with
-                size_t numberOfMiddleLines = numberOfLines - 2;
-                EditBuffer_shiftUp (
-                        editBuffer,
-                        startRow + 1, numberOfMiddleLines, 0);
-
-                START_ALL_CURSORS
-                        if (cursor->row > startRow) {
-                                cursor->row -= numberOfMiddleLines;
-                        }
-                        
-                        if (cursor->selectionRow > startRow) {
-                                cursor->selectionRow -= numberOfMiddleLines;
-                        }
-                END_ALL_CURSORS
-
-                endRow -= numberOfMiddleLines;
-
-                // since we deleted lines, there might be cursors that are now
-                // out of bounds, and we need to bring them back in.
-                EditBuffer_cursorsWrangle(editBuffer);
-        }
-        
-        numberOfLines = endRow - startRow + 1;
-
-        if (numberOfLines >= 2) {
-                // we have a start and end line
-                String *line = EditBuffer_getLine(editBuffer, startRow);
-                size_t toDelete = line->length - startColumn + endColumn + 2;
-                
-                for (size_t index = 0; index < toDelete; index ++) {
-                        EditBuffer_deleteRuneAt (
-                                editBuffer,
-                                startColumn, startRow);
+        if (startRow >= editBuffer->length) { return; }
+
+        // work out where the range stops, exclusive. if the end column is
+        // before the start of its line, this wraps around to zero, which is
+        // what we want.
+        size_t stopColumn = endColumn + 1;
+        size_t stopRow    = MIN(endRow, editBuffer->length - 1);
+        size_t stopLength = EditBuffer_peekLine(editBuffer, stopRow)->length;
+        if (stopRow < endRow || stopColumn > stopLength) {
+                if (stopRow + 1 < editBuffer->length) {
+                        stopColumn = 0;
+                        stopRow ++;
+                } else {
+                        stopColumn = stopLength;
                 }
+        }
+
+        if (stopRow < startRow) { return; }
+        if (stopRow == startRow && stopColumn <= startColumn) { return; }
+
+        EditBuffer_Edit edit = {
+                .startColumn  = startColumn, .startRow  = startRow,
+                .oldEndColumn = stopColumn,  .oldEndRow = stopRow,
+                .newEndColumn = startColumn, .newEndRow = startRow,
+        };
+        EditBuffer_recordDeletion(editBuffer, &edit);
+
+        String *startLine = EditBuffer_getLine(editBuffer, startRow);
+        if (stopRow == startRow) {
+                String_deleteRange(startLine, startColumn, stopColumn - 1);
         } else {
-                // we have a line
-                for (size_t index = startColumn; index <= endColumn; index ++) {
-                        EditBuffer_deleteRuneAt (
-                                editBuffer,
-                                startColumn, startRow);
+                if (startColumn < startLine->length) {
+                        String_deleteRange (
+                                startLine,
+                                startColumn,
+                                startLine->length - 1);
                 }
+
+                String *stopLine = EditBuffer_getLine(editBuffer, stopRow);
+                String_splitInto(stopLine, startLine, stopColumn);
+                EditBuffer_removeLines (
+                        editBuffer,
+                        startRow + 1,
+                        stopRow - startRow);
         }
+
+        EditBuffer_shiftCursors(editBuffer, &edit);
 }
 
-/* EditBuffer_shiftCursorsInLineAfter
- * Shifts all cursors in row that are positioned at or equal to column by
- * amount. This function should ONLY be used in rune insertion and deletion, and
- * not as a replacement for EditBuffer_Cursor_moveH.
+/* EditBuffer_copyText
+ * Copies the text from one position in the buffer to another, exclusive, onto
+ * the end of a block of text of length bytes, which has room for size bytes.
+ * The block grows if it needs to. Line breaks are copied as '\n'.
  */
-void EditBuffer_shiftCursorsInLineAfter (
+void EditBuffer_copyText (
         EditBuffer *editBuffer,
-        size_t column, size_t row,
-        int amount
+        size_t startColumn, size_t startRow,
+        size_t endColumn,   size_t endRow,
+        char   **text,
+        size_t *length,
+        size_t *size
 ) {
-        START_ALL_CURSORS
-                // shift cursor coordinates
-                if (
-                        cursor->row == row &&
-                        cursor->column >= column
-                ) {
-                        cursor->column = Utility_addToSizeT (
-                                cursor->column,
-                                amount);
+        for (size_t row = startRow; row <= endRow; row ++) {
+                String *line = EditBuffer_peekLine(editBuffer, row);
 
+                size_t start = 0;
+                size_t end   = line->byteLength;
+                if (row == startRow) {
+                        start = String_getOffset(line, startColumn);
                 }
-
-                // shift selection coordinates
-                if (
-                        cursor->selectionRow == row &&
-                        cursor->selectionColumn >= column
-                ) {
-                        cursor->selectionColumn = Utility_addToSizeT (
-                                cursor->selectionColumn,
-                                amount);
+                if (row == endRow) {
+                        end = String_getOffset(line, endColumn);
                 }
-        END_ALL_CURSORS
-}
 
-/* EditBuffer_mergeCursors
- * Removes redundant, overlapping cursors. This should be called whenever a
- * cursor moves.
- */
-void EditBuffer_mergeCursors (EditBuffer *editBuffer) {
-        // if we are currently looping over all cursors, don't merge yet
-        if (editBuffer->dontMerge) { return; }
-
-        START_ALL_CURSORS
-                for (
-                        size_t secondCursorIndex = index + 1;
-                        secondCursorIndex < editBuffer->amountOfCursors;
-                        secondCursorIndex ++
-                ) {
-                        EditBuffer_Cursor *secondCursor =
-                                editBuffer->cursors + secondCursorIndex;
-                        
-                        if (secondCursor->parent == NULL) { continue; }
-                        if (secondCursor == cursor)       { continue; }
-                        
-                        if (
-                                secondCursor->row    == cursor->row &&
-                                secondCursor->column == cursor->column
-                        ) {
-                                secondCursor->parent = NULL;
-                        }
-                }
-        END_ALL_CURSORS
-
-        START_ALL_CURSORS
-                if (cursor->parent != NULL) { continue; }
-                EditBuffer_Cursor *previousCursor = cursor;
-
-                for (
-                        size_t secondCursorIndex = 1;
-                        secondCursorIndex < editBuffer->amountOfCursors;
-                        secondCursorIndex ++
-                ) {
-                        EditBuffer_Cursor *secondCursor =
-                                editBuffer->cursors + secondCursorIndex;
-
-                        *previousCursor = *secondCursor;
-                        previousCursor = secondCursor;
+                size_t needed = *length + end - start + 1;
+                if (needed > *size) {
+                        *size = MAX(MAX(*size * 2, needed), 256);
+                        *text = realloc(*text, *size);
                 }
-                editBuffer->amountOfCursors --;
-                index --;
-        END_ALL_CURSORS
+
+                memcpy(*text + *length, line->buffer + start, end - start);
+                *length += end - start;
+                if (row < endRow) { (*text)[(*length) ++] = '\n'; }
+        }
 }
 
 /* EditBuffer_scroll
@@ -499,76 +511,13 @@ void EditBuffer_scroll (EditBuffer *editBuffer, int amount) {
                 editBuffer->length);
 }
 
-/* EditBuffer_getLine
- * Returns the line at row. If it does not exist, this function returns NULL.
- */
-String *EditBuffer_getLine (EditBuffer *editBuffer, size_t row) {
-        if (row >= editBuffer->length) { return NULL; }
-        return editBuffer->lines[row];
-}
-
-
-/* EditBuffer_placeLine
- * Inserts a line at the specified index, moving all lines after it downwards.
- */
-void EditBuffer_placeLine (
-        EditBuffer *editBuffer,
-        String     *line,
-        size_t     index
-) {
-        EditBuffer_shiftDown(editBuffer, index, 1);
-        editBuffer->lines[index] = line;
-}
-
-/* EditBuffer_shiftDown
- * Shifts the contents of the edit buffer down after location, leaving a gap of
- * NULL pointers. This reallocates the buffer to accommodate the gap.
- */
-void EditBuffer_shiftDown (
-        EditBuffer *editBuffer,
-        size_t     location,
-        size_t     amount
-) {
-        size_t end       = editBuffer->length + amount;
-        size_t beginning = location + amount - 1;
-        EditBuffer_realloc(editBuffer, end);
-
-        for (size_t current = end - 1; current > beginning; current --) {
-                size_t target = current - amount;
-                editBuffer->lines[current] = editBuffer->lines[target];
-                editBuffer->lines[target] = NULL;
-        }
-}
-
-/* EditBuffer_shiftUp
- * Shifts the contents of the edit buffer up after location. If keep is 0, the
- * overwritten lines will be freed. Unless something else needs to be done with
- * them, this should always be set to 0!
- */
-void EditBuffer_shiftUp (
-        EditBuffer *editBuffer,
-        size_t     location,
-        size_t     amount,
-        int        keep
-) {
-        size_t end      = editBuffer->length - amount;
-        size_t toDelete = amount;
-        for (size_t index = location; index < end; index ++) {
-                if (!keep && toDelete > 0) {
-                        String_free(editBuffer->lines[index]);
-                        toDelete --;
-                }
-                editBuffer->lines[index] =
-                        editBuffer->lines[index + amount];
-        }
-        
-        EditBuffer_realloc(editBuffer, end);
-}
-
 /* EditBuffer_cursorsInsertRune
  * Inserts a rune at all cursors.
  */
 void EditBuffer_cursorsInsertRune (EditBuffer *editBuffer, Rune rune) {
+        if (editBuffer->readOnly || !EditBuffer_isLoaded(editBuffer)) {
+                return;
+        }
         START_ALL_CURSORS_BATCH_OPERATION
                 EditBuffer_Cursor_insertRune(cursor, rune);
         END_ALL_CURSORS_BATCH_OPERATION
@@ -578,6 +527,9 @@ void EditBuffer_cursorsInsertRune (EditBuffer *editBuffer, Rune rune) {
  * Deletes all text in the selection of all cursors.
  */
 void EditBuffer_cursorsDeleteSelection (EditBuffer *editBuffer) {
+        if (editBuffer->readOnly || !EditBuffer_isLoaded(editBuffer)) {
+                return;
+        }
         START_ALL_CURSORS_BATCH_OPERATION
                 EditBuffer_Cursor_deleteSelection(cursor);
         END_ALL_CURSORS_BATCH_OPERATION
@@ -587,10 +539,12 @@ void EditBuffer_cursorsDeleteSelection (EditBuffer *editBuffer) {
  * Deletes a rune at all cursors.
  */
 void EditBuffer_cursorsDeleteRune (EditBuffer *editBuffer) {
+        if (editBuffer->readOnly || !EditBuffer_isLoaded(editBuffer)) {
+                return;
+        }
         START_ALL_CURSORS_BATCH_OPERATION
                 EditBuffer_Cursor_deleteRune(cursor);
         END_ALL_CURSORS_BATCH_OPERATION
-        EditBuffer_mergeCursors(editBuffer);
 }
 
 /* EditBuffer_cursorsBackspaceRune
@@ -598,10 +552,12 @@ void EditBuffer_cursorsDeleteRune (EditBuffer *editBuffer) {
  * Cursors that cannot be moved back do not delete a rune.
  */
 void EditBuffer_cursorsBackspaceRune (EditBuffer *editBuffer) {
+        if (editBuffer->readOnly || !EditBuffer_isLoaded(editBuffer)) {
+                return;
+        }
         START_ALL_CURSORS_BATCH_OPERATION
                 EditBuffer_Cursor_backspaceRune(cursor);
         END_ALL_CURSORS_BATCH_OPERATION
-        EditBuffer_mergeCursors(editBuffer);
 }
 
 /* EditBuffer_cursorsMoveH
@@ -611,7 +567,6 @@ void EditBuffer_cursorsMoveH (EditBuffer *editBuffer, int amount) {
         START_ALL_CURSORS_BATCH_OPERATION
                 EditBuffer_Cursor_moveH(cursor, amount);
         END_ALL_CURSORS_BATCH_OPERATION
-        EditBuffer_mergeCursors(editBuffer);
 }
 
 /* EditBuffer_cursorsMoveV
@@ -621,7 +576,6 @@ void EditBuffer_cursorsMoveV (EditBuffer *editBuffer, int amount) {
         START_ALL_CURSORS_BATCH_OPERATION
                 EditBuffer_Cursor_moveV(cursor, amount);
         END_ALL_CURSORS_BATCH_OPERATION
-        EditBuffer_mergeCursors(editBuffer);
 }
 
 // TODO
@@ -650,7 +604,18 @@ void EditBuffer_cursorsSelectV (EditBuffer *editBuffer, int amount) {
 void EditBuffer_cursorsSelectWordH (EditBuffer *, int);
 void EditBuffer_cursorsSelectMoreV (EditBuffer *, int);
 void EditBuffer_cursorsChangeIndent (EditBuffer *, int);
-void EditBuffer_cursorsInsertString (EditBuffer *, String *);
+
+/* EditBuffer_cursorsInsertString
+ * Inserts a string at all cursors.
+ */
+void EditBuffer_cursorsInsertString (EditBuffer *editBuffer, String *string) {
+        if (editBuffer->readOnly || !EditBuffer_isLoaded(editBuffer)) {
+                return;
+        }
+        START_ALL_CURSORS_BATCH_OPERATION
+                EditBuffer_Cursor_insertString(cursor, string);
+        END_ALL_CURSORS_BATCH_OPERATION
+}
 
 /* EditBuffer_cursorsWrangle
  * Moves all cursors within bounds.
@@ -659,36 +624,4 @@ void EditBuffer_cursorsWrangle (EditBuffer *editBuffer) {
         START_ALL_CURSORS_BATCH_OPERATION
                 EditBuffer_Cursor_wrangle(cursor);
         END_ALL_CURSORS_BATCH_OPERATION
-        EditBuffer_mergeCursors(editBuffer);
-}
-
-/* EditBuffer_realloc
- * Resizes the internal buffer of the edit buffer to accomodate a file of
- * newLength lines.
- */
-void EditBuffer_realloc (EditBuffer *editBuffer, size_t newLength) {
-        if (newLength == editBuffer->length) { return; }
-
-        if (newLength < editBuffer->size) {
-                // if the buffer is shrinking, just set the size to the new
-                // size.
-                editBuffer->size = newLength;
-        } else {
-                // try multiplying the current size by 2
-                editBuffer->size *= 2;
-                // if that isn't enough, just exactly match the new size.
-                if (newLength > editBuffer->size) {
-                        editBuffer->size = newLength;
-                }
-        }
-        
-        editBuffer->lines = realloc (
-                editBuffer->lines,
-                editBuffer->size * sizeof(String *));
-        editBuffer->length = newLength;
-
-        // make sure scroll is within bounds
-        if (editBuffer->scroll >= editBuffer->length) {
-                editBuffer->scroll = editBuffer->length;
-        }
 }
@@ -0,0 +1,208 @@
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "module.h"
+
+// the most bytes that are read in from a followed file at a time. if more than
+// this was added, the rest is read in the next time the buffer is updated, so
+// a file that grows very fast can't hold everything else up.
+#define FOLLOW_READ_LIMIT (1024 * 1024)
+
+static int  EditBuffer_Follow_drain   (EditBuffer_Follow *);
+static void EditBuffer_Follow_restart (EditBuffer *);
+static void EditBuffer_Follow_add     (EditBuffer *, const char *, size_t);
+
+/* EditBuffer_startFollow
+ * Starts watching the file of a buffer that was just loaded from follow.file,
+ * so that whatever is written onto the end of it later can be read in. If it
+ * can't be watched, the buffer is left as it is without following the file.
+ */
+Error EditBuffer_startFollow (EditBuffer *editBuffer) {
+        EditBuffer_Follow *follow = &editBuffer->follow;
+
+        follow->watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (
+                follow->watch < 0 ||
+                inotify_add_watch (
+                        follow->watch,
+                        editBuffer->filePath,
+                        IN_MODIFY) < 0
+        ) {
+                EditBuffer_stopFollow(editBuffer);
+                return Error_cantOpenFile;
+        }
+
+        // everything up to here was already loaded
+        follow->offset = editBuffer->original.size;
+        return Error_none;
+}
+
+/* EditBuffer_isFollowing
+ * Returns 1 if the buffer is following its file as it grows, and 0 if it isn't.
+ */
+int EditBuffer_isFollowing (EditBuffer *editBuffer) {
+        return editBuffer->follow.watch >= 0;
+}
+
+/* EditBuffer_updateFollow
+ * Adds whatever was added onto the end of a followed file since the last update
+ * onto the end of the buffer. This never blocks: if the file hasn't changed,
+ * nothing is read at all, and at most FOLLOW_READ_LIMIT bytes are read at once.
+ * Returns 1 if anything was added, and 0 if nothing was.
+ */
+int EditBuffer_updateFollow (EditBuffer *editBuffer) {
+        EditBuffer_Follow *follow = &editBuffer->follow;
+        if (follow->watch < 0) { return 0; }
+
+        // the events are always taken, even if nothing can be read yet, so
+        // that whatever is waiting on the inotify instance isn't woken up
+        // over and over again
+        if (EditBuffer_Follow_drain(follow)) { follow->behind = 1; }
+        if (!follow->behind) { return 0; }
+
+        // the lines that were already in the file have to all be in the
+        // buffer first
+        if (EditBuffer_isLoading(editBuffer)) { return 0; }
+        EditBuffer_finishLoad(editBuffer);
+
+        struct stat info;
+        if (fstat(follow->file, &info) != 0) { return 0; }
+        size_t size = (size_t)(info.st_size);
+
+        // if the file got shorter, it was emptied out and written over again,
+        // so it is read again from the start
+        if (size < follow->offset) { EditBuffer_Follow_restart(editBuffer); }
+
+        size_t length = MIN(size - follow->offset, FOLLOW_READ_LIMIT);
+        follow->behind = 0;
+        if (length == 0) { return 0; }
+
+        char   *buffer = malloc(length);
+        ssize_t amountRead;
+        do {
+                amountRead = pread (
+                        follow->file, buffer, length,
+                        (off_t)(follow->offset));
+        } while (amountRead < 0 && errno == EINTR);
+
+        if (amountRead <= 0) {
+                free(buffer);
+                return 0;
+        }
+        length = (size_t)(amountRead);
+
+        // only whole lines are taken in if there are any, so that text isn't
+        // cut off in the middle of a character. whatever is left over gets
+        // read again next time.
+        size_t taken = length;
+        while (taken > 0 && buffer[taken - 1] != '\n') { taken --; }
+        if (taken == 0) { taken = length; }
+
+        EditBuffer_Follow_add(editBuffer, buffer, taken);
+        free(buffer);
+
+        follow->offset += taken;
+        follow->behind  = follow->offset < size;
+        return 1;
+}
+
+/* EditBuffer_stopFollow
+ * Stops following the file of the buffer, if it is being followed.
+ */
+void EditBuffer_stopFollow (EditBuffer *editBuffer) {
+        EditBuffer_Follow *follow = &editBuffer->follow;
+
+        if (follow->watch >= 0) { close(follow->watch); }
+        if (follow->file  >= 0) { close(follow->file);  }
+        follow->watch  = -1;
+        follow->file   = -1;
+        follow->offset = 0;
+        follow->behind = 0;
+}
+
+/* EditBuffer_Follow_drain
+ * Reads every event waiting on the inotify instance of a followed file, without
+ * blocking. Returns 1 if there were any, and 0 if there weren't.
+ */
+static int EditBuffer_Follow_drain (EditBuffer_Follow *follow) {
+        char events[4096]
+                __attribute__((aligned(__alignof__(struct inotify_event))));
+
+        int changed = 0;
+        for (;;) {
+                ssize_t amountRead = read (
+                        follow->watch,
+                        events, sizeof(events));
+                if (amountRead < 0 && errno == EINTR) { continue; }
+                if (amountRead <= 0) { break; }
+                changed = 1;
+        }
+
+        return changed;
+}
+
+/* EditBuffer_Follow_restart
+ * Empties out a followed buffer, so that its file can be read into it again
+ * from the start. The file and the inotify instance are kept open the whole
+ * time, so anything waiting on them doesn't need to know.
+ */
+static void EditBuffer_Follow_restart (EditBuffer *editBuffer) {
+        EditBuffer_Follow follow = editBuffer->follow;
+        char filePath[PATH_MAX + 1];
+        Utility_copyCString(filePath, editBuffer->filePath, PATH_MAX);
+
+        editBuffer->follow.watch = -1;
+        editBuffer->follow.file  = -1;
+        EditBuffer_reset(editBuffer);
+
+        Utility_copyCString(editBuffer->filePath, filePath, PATH_MAX);
+        EditBuffer_placeLine(editBuffer, String_new(""), 0);
+        editBuffer->readOnly      = 1;
+        editBuffer->follow        = follow;
+        editBuffer->follow.offset = 0;
+}
+
+/* EditBuffer_Follow_add
+ * Adds length bytes of text from a followed file onto the end of the buffer.
+ * The last line of the buffer is whatever came after the last line break in the
+ * file, so the text up to the first line break continues it, and the rest is
+ * split up into new lines.
+ */
+static void EditBuffer_Follow_add (
+        EditBuffer *editBuffer,
+        const char *buffer,
+        size_t     length
+) {
+        const char *lineBreak = memchr(buffer, '\n', length);
+        size_t      end       = length;
+        if (lineBreak != NULL) { end = (size_t)(lineBreak - buffer); }
+
+        String *last = EditBuffer_getLine(editBuffer, editBuffer->length - 1);
+        String_addBytes(last, buffer, end);
+        if (lineBreak == NULL) { return; }
+
+        size_t amountOfLines = 1;
+        for (size_t index = end + 1; index < length; index ++) {
+                if (buffer[index] == '\n') { amountOfLines ++; }
+        }
+
+        String **lines = malloc(amountOfLines * sizeof(String *));
+        size_t   start = end + 1;
+        for (size_t index = 0; index < amountOfLines; index ++) {
+                lineBreak = memchr(buffer + start, '\n', length - start);
+                end = length;
+                if (lineBreak != NULL) { end = (size_t)(lineBreak - buffer); }
+
+                lines[index] = String_new("");
+                String_addBytes(lines[index], buffer + start, end - start);
+                start = end + 1;
+        }
+
+        EditBuffer_placeLines (
+                editBuffer,
+                lines, amountOfLines,
+                editBuffer->length);
+        free(lines);
+}
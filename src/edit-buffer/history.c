@@ -0,0 +1,331 @@
+#include "module.h"
+
+static void EditBuffer_record        (EditBuffer *, EditBuffer_Edit *, int);
+static int  EditBuffer_coalesceDelta (EditBuffer_History *, EditBuffer_Delta *);
+static void EditBuffer_trimHistory   (EditBuffer_History *);
+static void EditBuffer_applyDelta    (EditBuffer *, EditBuffer_Delta *, int);
+
+/* EditBuffer_recordInsertion
+ * Records an edit that inserted text into the undo history and the journal.
+ * This must be called after the text has been inserted, since the text is read
+ * back out of the buffer.
+ */
+void EditBuffer_recordInsertion (
+        EditBuffer      *editBuffer,
+        EditBuffer_Edit *edit
+) {
+        EditBuffer_journalEdit(editBuffer, edit, 0);
+        EditBuffer_record(editBuffer, edit, 0);
+}
+
+/* EditBuffer_recordDeletion
+ * Records an edit that deleted text from the buffer into the undo history and
+ * the journal. This must be called before the text is deleted, since the text
+ * is read out of the buffer.
+ */
+void EditBuffer_recordDeletion (
+        EditBuffer      *editBuffer,
+        EditBuffer_Edit *edit
+) {
+        EditBuffer_journalEdit(editBuffer, edit, 1);
+        EditBuffer_record(editBuffer, edit, 1);
+}
+
+/* EditBuffer_undo
+ * Undoes the last group of deltas in the history. The primary cursor is moved
+ * to where the change was, and all other cursors are removed.
+ */
+void EditBuffer_undo (EditBuffer *editBuffer) {
+        EditBuffer_History *history = &editBuffer->history;
+        if (history->current == 0) { return; }
+
+        history->replaying = 1;
+        EditBuffer_clearExtraCursors(editBuffer);
+
+        EditBuffer_Delta *delta;
+        do {
+                history->current --;
+                delta = &history->deltas[history->current];
+                EditBuffer_applyDelta(editBuffer, delta, 0);
+        } while (!delta->startsGroup && history->current > 0);
+
+        // deleted text is put back, so the cursor goes after it
+        EditBuffer_Cursor *cursor = EditBuffer_getPrimaryCursor(editBuffer);
+        if (delta->deleted) {
+                EditBuffer_Cursor_moveTo (
+                        cursor,
+                        delta->endColumn,
+                        delta->endRow);
+        } else {
+                EditBuffer_Cursor_moveTo (
+                        cursor,
+                        delta->startColumn,
+                        delta->startRow);
+        }
+
+        history->replaying = 0;
+        history->sealed    = 1;
+}
+
+/* EditBuffer_redo
+ * Redoes the last group of deltas that was undone. The primary cursor is moved
+ * to where the change was, and all other cursors are removed.
+ */
+void EditBuffer_redo (EditBuffer *editBuffer) {
+        EditBuffer_History *history = &editBuffer->history;
+        if (history->current >= history->amountOfDeltas) { return; }
+
+        history->replaying = 1;
+        EditBuffer_clearExtraCursors(editBuffer);
+
+        EditBuffer_Delta *delta;
+        do {
+                delta = &history->deltas[history->current];
+                history->current ++;
+                EditBuffer_applyDelta(editBuffer, delta, 1);
+        } while (
+                history->current < history->amountOfDeltas &&
+                !history->deltas[history->current].startsGroup);
+
+        // inserted text is put back, so the cursor goes after it
+        EditBuffer_Cursor *cursor = EditBuffer_getPrimaryCursor(editBuffer);
+        if (delta->deleted) {
+                EditBuffer_Cursor_moveTo (
+                        cursor,
+                        delta->startColumn,
+                        delta->startRow);
+        } else {
+                EditBuffer_Cursor_moveTo (
+                        cursor,
+                        delta->endColumn,
+                        delta->endRow);
+        }
+
+        history->replaying = 0;
+        history->sealed    = 1;
+}
+
+/* EditBuffer_freeHistory
+ * Frees the undo history of an edit buffer.
+ */
+void EditBuffer_freeHistory (EditBuffer *editBuffer) {
+        free(editBuffer->history.deltas);
+        free(editBuffer->history.text);
+        editBuffer->history = (const EditBuffer_History) { 0 };
+}
+
+/* EditBuffer_record
+ * Adds an edit to the undo history, merging it into the last delta if it simply
+ * continues it, like when typing out a word or holding down backspace.
+ */
+static void EditBuffer_record (
+        EditBuffer      *editBuffer,
+        EditBuffer_Edit *edit,
+        int             deleted
+) {
+        EditBuffer_History *history = &editBuffer->history;
+        if (history->replaying) { return; }
+
+        // anything that was undone can't be redone anymore
+        if (history->current < history->amountOfDeltas) {
+                history->textLength =
+                        history->deltas[history->current].textStart;
+                history->amountOfDeltas = history->current;
+        }
+
+        EditBuffer_Delta delta = {
+                .startColumn = edit->startColumn,
+                .startRow    = edit->startRow,
+                .endColumn   = edit->newEndColumn,
+                .endRow      = edit->newEndRow,
+                .textStart   = history->textLength,
+                .deleted     = (uint8_t)(deleted),
+                .startsGroup = !history->grouping || !history->groupStarted,
+        };
+        if (deleted) {
+                delta.endColumn = edit->oldEndColumn;
+                delta.endRow    = edit->oldEndRow;
+        }
+
+        // a range can start past the end of its line
+        delta.startColumn = MIN (
+                delta.startColumn,
+                EditBuffer_peekLine(editBuffer, delta.startRow)->length);
+        EditBuffer_copyText (
+                editBuffer,
+                delta.startColumn, delta.startRow,
+                delta.endColumn,   delta.endRow,
+                &history->text, &history->textLength, &history->textSize);
+        delta.textLength = history->textLength - delta.textStart;
+
+        if (!EditBuffer_coalesceDelta(history, &delta)) {
+                if (history->amountOfDeltas >= history->deltasSize) {
+                        history->deltasSize =
+                                MAX(history->deltasSize * 2, 64);
+                        history->deltas = realloc (
+                                history->deltas,
+                                history->deltasSize *
+                                        sizeof(EditBuffer_Delta));
+                }
+
+                history->deltas[history->amountOfDeltas ++] = delta;
+        }
+
+        // anything else done during the same batch operation joins the group
+        // of this delta, even if it got merged into an older one
+        history->groupStarted = 1;
+        history->current = history->amountOfDeltas;
+        history->sealed  = 0;
+        EditBuffer_trimHistory(history);
+}
+
+/* EditBuffer_coalesceDelta
+ * Merges delta, whose text has already been copied onto the end of the history
+ * text, into the last delta in the history if it continues it on the same line.
+ * This only happens when both deltas are on their own in their groups, so
+ * batch operations over many cursors still get undone all at once. Returns 1
+ * if the delta was merged, and 0 if it needs to be added by itself.
+ */
+static int EditBuffer_coalesceDelta (
+        EditBuffer_History *history,
+        EditBuffer_Delta   *delta
+) {
+        if (history->sealed || history->amountOfDeltas == 0) { return 0; }
+        if (!delta->startsGroup) { return 0; }
+
+        EditBuffer_Delta *previous =
+                &history->deltas[history->amountOfDeltas - 1];
+        if (!previous->startsGroup)                { return 0; }
+        if (previous->deleted != delta->deleted)   { return 0; }
+        if (previous->startRow != previous->endRow) { return 0; }
+        if (delta->startRow != delta->endRow)       { return 0; }
+        if (delta->startRow != previous->startRow)  { return 0; }
+
+        if (!delta->deleted) {
+                // typing: the new text goes right after the previous text
+                if (delta->startColumn != previous->endColumn) { return 0; }
+                previous->endColumn   = delta->endColumn;
+                previous->textLength += delta->textLength;
+                return 1;
+        }
+
+        if (delta->startColumn == previous->startColumn) {
+                // deleting forwards: the new text came after the previous text
+                previous->endColumn  +=
+                        delta->endColumn - delta->startColumn;
+                previous->textLength += delta->textLength;
+                return 1;
+        }
+
+        if (delta->endColumn == previous->startColumn) {
+                // backspacing: the new text came before the previous text, so
+                // the two need to be swapped around
+                char *text = malloc(delta->textLength);
+                memcpy (
+                        text,
+                        history->text + delta->textStart,
+                        delta->textLength);
+                memmove (
+                        history->text + previous->textStart + delta->textLength,
+                        history->text + previous->textStart,
+                        previous->textLength);
+                memcpy (
+                        history->text + previous->textStart,
+                        text,
+                        delta->textLength);
+                free(text);
+
+                previous->startColumn = delta->startColumn;
+                previous->textLength += delta->textLength;
+                return 1;
+        }
+
+        return 0;
+}
+
+/* EditBuffer_trimHistory
+ * Drops the oldest groups of deltas once the history takes up more memory than
+ * Options_undoLimit allows. Enough is dropped to get back down to three
+ * quarters of the limit, so this doesn't happen again on the very next edit.
+ */
+static void EditBuffer_trimHistory (EditBuffer_History *history) {
+        size_t deltaSize = sizeof(EditBuffer_Delta);
+        size_t used = history->amountOfDeltas * deltaSize + history->textLength;
+        if (used <= Options_undoLimit) { return; }
+
+        size_t target  = Options_undoLimit / 4 * 3;
+        size_t dropped = 0;
+        while (dropped < history->amountOfDeltas && used > target) {
+                // drop whole groups, so no group is left half done
+                do {
+                        dropped ++;
+                } while (
+                        dropped < history->amountOfDeltas &&
+                        !history->deltas[dropped].startsGroup);
+
+                used = (history->amountOfDeltas - dropped) * deltaSize;
+                if (dropped < history->amountOfDeltas) {
+                        used += history->textLength -
+                                history->deltas[dropped].textStart;
+                }
+        }
+
+        size_t textDropped = history->textLength;
+        if (dropped < history->amountOfDeltas) {
+                textDropped = history->deltas[dropped].textStart;
+        }
+
+        history->amountOfDeltas -= dropped;
+        history->current        -= MIN(history->current, dropped);
+        history->textLength     -= textDropped;
+        memmove (
+                history->deltas,
+                history->deltas + dropped,
+                history->amountOfDeltas * deltaSize);
+        memmove (
+                history->text,
+                history->text + textDropped,
+                history->textLength);
+
+        for (size_t index = 0; index < history->amountOfDeltas; index ++) {
+                history->deltas[index].textStart -= textDropped;
+        }
+
+        // if part of the group that is being recorded right now had to go,
+        // what is left of it becomes a group of its own
+        if (history->amountOfDeltas > 0) {
+                history->deltas[0].startsGroup = 1;
+        }
+}
+
+/* EditBuffer_applyDelta
+ * Does a delta to the buffer if forward is set, and undoes it otherwise.
+ */
+static void EditBuffer_applyDelta (
+        EditBuffer       *editBuffer,
+        EditBuffer_Delta *delta,
+        int              forward
+) {
+        if (delta->deleted == forward) {
+                // the end is exclusive, but the range to delete is inclusive.
+                // if the end is at the start of a line, this wraps around to
+                // the line break before it.
+                EditBuffer_deleteRange (
+                        editBuffer,
+                        delta->startColumn, delta->startRow,
+                        delta->endColumn - 1, delta->endRow);
+                return;
+        }
+
+        const char *buffer = editBuffer->history.text + delta->textStart;
+        String *text = String_new("");
+        String_addValidBytes (
+                text,
+                buffer, delta->textLength,
+                Unicode_utf8CountRunes(buffer, delta->textLength));
+        EditBuffer_insertStringAt (
+                editBuffer,
+                delta->startColumn, delta->startRow,
+                text);
+        String_free(text);
+}
@@ -0,0 +1,247 @@
+#include <unistd.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "module.h"
+
+// files smaller than this many bytes per thread aren't worth splitting up
+#define INDEX_CHUNK_MINIMUM (4 * 1024 * 1024)
+#define INDEX_THREADS_MAXIMUM 64
+
+/* EditBuffer_IndexChunk
+ * A chunk of the original file buffer to be indexed by one thread. Every line
+ * that begins inside of the chunk is counted in amountOfLines, and the start of
+ * one out of every stride of them is stored in starts. rows holds the row of
+ * each one, counting from the first line in the chunk, but only if stride is
+ * more than one.
+ */
+typedef struct {
+        const char *data;
+        size_t      start;
+        size_t      end;
+        size_t      stride;
+
+        size_t *starts;
+        size_t *rows;
+        size_t  amountOfStarts;
+        size_t  size;
+        size_t  amountOfLines;
+        size_t  nextStart;
+} EditBuffer_IndexChunk;
+
+static void *EditBuffer_IndexChunk_run (void *);
+static void  EditBuffer_IndexChunk_add (EditBuffer_IndexChunk *, size_t);
+
+/* EditBuffer_LineIndex_new
+ * Returns an index with just the first line in it, which always starts at zero.
+ * Only one out of every stride lines will have its start kept.
+ */
+EditBuffer_LineIndex EditBuffer_LineIndex_new (size_t stride) {
+        EditBuffer_LineIndex lines = {
+                .starts         = malloc(sizeof(size_t)),
+                .amountOfStarts = 1,
+                .amountOfLines  = 1,
+                .stride         = stride,
+        };
+        lines.starts[0] = 0;
+
+        if (stride > 1) {
+                lines.rows    = malloc(sizeof(size_t));
+                lines.rows[0] = 0;
+        }
+        return lines;
+}
+
+/* EditBuffer_LineIndex_copy
+ * Returns a copy of an index.
+ */
+EditBuffer_LineIndex EditBuffer_LineIndex_copy (EditBuffer_LineIndex *lines) {
+        EditBuffer_LineIndex copy = *lines;
+        size_t size = lines->amountOfStarts * sizeof(size_t);
+
+        copy.starts = malloc(size);
+        memcpy(copy.starts, lines->starts, size);
+        if (lines->rows != NULL) {
+                copy.rows = malloc(size);
+                memcpy(copy.rows, lines->rows, size);
+        }
+        return copy;
+}
+
+/* EditBuffer_LineIndex_free
+ * Frees the contents of an index.
+ */
+void EditBuffer_LineIndex_free (EditBuffer_LineIndex *lines) {
+        free(lines->starts);
+        free(lines->rows);
+        *lines = (const EditBuffer_LineIndex) { 0 };
+}
+
+/* EditBuffer_indexLines
+ * Finds the start of every line that begins between start and end in data, and
+ * adds them onto the end of an index. Each line break starts a new line. Big
+ * ranges are split into chunks that are scanned at the same time, one per
+ * processor, and the line starts found in each one are then joined together in
+ * order.
+ */
+void EditBuffer_indexLines (
+        const char           *data,
+        size_t               start,
+        size_t               end,
+        EditBuffer_LineIndex *lines
+) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t amountOfChunks = (end - start) / INDEX_CHUNK_MINIMUM;
+        amountOfChunks = MIN(amountOfChunks, (size_t)(MAX(processors, 1)));
+        amountOfChunks = MIN(amountOfChunks, INDEX_THREADS_MAXIMUM);
+        amountOfChunks = MAX(amountOfChunks, 1);
+
+        EditBuffer_IndexChunk chunks[INDEX_THREADS_MAXIMUM] = { 0 };
+        pthread_t             threads[INDEX_THREADS_MAXIMUM];
+        int                   started[INDEX_THREADS_MAXIMUM] = { 0 };
+
+        size_t chunkSize = (end - start) / amountOfChunks;
+        for (size_t index = 0; index < amountOfChunks; index ++) {
+                EditBuffer_IndexChunk *chunk = &chunks[index];
+                chunk->data   = data;
+                chunk->start  = start + index * chunkSize;
+                chunk->end    = start + (index + 1) * chunkSize;
+                chunk->stride = lines->stride;
+                if (index == amountOfChunks - 1) { chunk->end = end; }
+
+                // the first chunk is done on this thread, once the rest
+                // have been started. if a thread can't be made, its chunk is
+                // done here too.
+                if (index == 0) { continue; }
+                started[index] = pthread_create (
+                        &threads[index], NULL,
+                        EditBuffer_IndexChunk_run, chunk) == 0;
+        }
+
+        for (size_t index = 0; index < amountOfChunks; index ++) {
+                if (started[index]) {
+                        pthread_join(threads[index], NULL);
+                } else {
+                        EditBuffer_IndexChunk_run(&chunks[index]);
+                }
+        }
+
+        size_t total = lines->amountOfStarts;
+        for (size_t index = 0; index < amountOfChunks; index ++) {
+                total += chunks[index].amountOfStarts;
+        }
+
+        size_t size = MAX(total, 1) * sizeof(size_t);
+        lines->starts = realloc(lines->starts, size);
+        if (lines->rows != NULL) { lines->rows = realloc(lines->rows, size); }
+
+        for (size_t index = 0; index < amountOfChunks; index ++) {
+                EditBuffer_IndexChunk *chunk = &chunks[index];
+                memcpy (
+                        lines->starts + lines->amountOfStarts,
+                        chunk->starts,
+                        chunk->amountOfStarts * sizeof(size_t));
+
+                // rows in the chunk count from its first line, which is the
+                // first one that isn't in the index yet
+                for (
+                        size_t kept = 0;
+                        lines->rows != NULL && kept < chunk->amountOfStarts;
+                        kept ++
+                ) {
+                        lines->rows[lines->amountOfStarts + kept] =
+                                lines->amountOfLines + chunk->rows[kept];
+                }
+
+                lines->amountOfStarts += chunk->amountOfStarts;
+                lines->amountOfLines  += chunk->amountOfLines;
+                free(chunk->starts);
+                free(chunk->rows);
+        }
+}
+
+/* EditBuffer_IndexChunk_run
+ * Finds every line break in a chunk, and stores where the line after it starts.
+ * Where SSE2 is available, the bytes are compared sixteen at a time.
+ */
+static void *EditBuffer_IndexChunk_run (void *argument) {
+        EditBuffer_IndexChunk *chunk = argument;
+        const char *data  = chunk->data;
+        size_t      index = chunk->start;
+
+        // guess at about one line every 64 bytes to start with
+        chunk->size = (chunk->end - chunk->start) / 64 / chunk->stride + 16;
+        chunk->starts = malloc(chunk->size * sizeof(size_t));
+        if (chunk->stride > 1) {
+                chunk->rows = malloc(chunk->size * sizeof(size_t));
+        }
+
+#ifdef __SSE2__
+        // check 64 bytes at a time, putting together one bit per byte that
+        // is a line break
+        __m128i newlines = _mm_set1_epi8('\n');
+        for (; index + 64 <= chunk->end; index += 64) {
+                uint64_t mask = 0;
+                for (int part = 0; part < 4; part ++) {
+                        __m128i bytes = _mm_loadu_si128 ((const __m128i *)(
+                                (const void *)(data + index + part * 16)));
+                        uint64_t bits = (uint16_t)(_mm_movemask_epi8 (
+                                _mm_cmpeq_epi8(bytes, newlines)));
+                        mask |= bits << (part * 16);
+                }
+
+                // if none of the lines that start here are kept, they only
+                // need to be counted
+                size_t found = (size_t)(__builtin_popcountll(mask));
+                if (chunk->amountOfLines + found <= chunk->nextStart) {
+                        chunk->amountOfLines += found;
+                        continue;
+                }
+
+                while (mask != 0) {
+                        size_t bit = (size_t)(__builtin_ctzll(mask));
+                        EditBuffer_IndexChunk_add(chunk, index + bit + 1);
+                        mask &= mask - 1;
+                }
+        }
+#endif
+
+        for (; index < chunk->end; index ++) {
+                if (data[index] == '\n') {
+                        EditBuffer_IndexChunk_add(chunk, index + 1);
+                }
+        }
+
+        return NULL;
+}
+
+/* EditBuffer_IndexChunk_add
+ * Adds the start of a line to a chunk. It is only kept if it is one out of
+ * every stride lines.
+ */
+static void EditBuffer_IndexChunk_add (
+        EditBuffer_IndexChunk *chunk,
+        size_t lineStart
+) {
+        size_t row = chunk->amountOfLines ++;
+        if (row != chunk->nextStart) { return; }
+        chunk->nextStart += chunk->stride;
+
+        if (chunk->amountOfStarts == chunk->size) {
+                chunk->size *= 2;
+                chunk->starts = realloc (
+                        chunk->starts,
+                        chunk->size * sizeof(size_t));
+                if (chunk->rows != NULL) {
+                        chunk->rows = realloc (
+                                chunk->rows,
+                                chunk->size * sizeof(size_t));
+                }
+        }
+
+        chunk->starts[chunk->amountOfStarts] = lineStart;
+        if (chunk->rows != NULL) { chunk->rows[chunk->amountOfStarts] = row; }
+        chunk->amountOfStarts ++;
+}
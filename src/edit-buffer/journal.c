@@ -0,0 +1,774 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "module.h"
+
+#define JOURNAL_MAGIC "WYVJRNL1"
+
+// compacted journals are written out in chunks of about this size
+#define JOURNAL_CHUNK_SIZE (1024 * 1024)
+
+typedef enum {
+        EditBuffer_JournalKind_insert = 1,
+        EditBuffer_JournalKind_delete,
+        EditBuffer_JournalKind_checkpoint,
+        EditBuffer_JournalKind_original,
+        EditBuffer_JournalKind_line
+} EditBuffer_JournalKind;
+
+/* EditBuffer_JournalRecord
+ * One record in a journal file, followed by length bytes of text. Insertions
+ * put their text at the start position, and deletions remove everything from
+ * the start position up to the end position. A checkpoint clears the buffer,
+ * and is followed by records that add lines back onto the end of it: either a
+ * run of lines from the original file buffer, from startRow for endRow lines,
+ * or a single line of text. The checksum covers everything after it, text
+ * included, so records that were only partly written are never replayed.
+ */
+typedef struct {
+        uint32_t checksum;
+        uint32_t kind;
+        uint64_t startRow;
+        uint64_t startColumn;
+        uint64_t endRow;
+        uint64_t endColumn;
+        uint64_t length;
+} EditBuffer_JournalRecord;
+
+static void   EditBuffer_replayJournal  (EditBuffer *, const char *, size_t);
+static size_t EditBuffer_replayRecords  (
+        EditBuffer *,
+        const char *,
+        size_t, size_t);
+static int    EditBuffer_replayRecord   (
+        EditBuffer *,
+        EditBuffer_JournalRecord *,
+        const char *);
+static void   EditBuffer_rebaseJournal  (EditBuffer *);
+static int    EditBuffer_adoptSaved     (
+        EditBuffer *,
+        EditBuffer_Original *,
+        const char *,
+        size_t);
+static void   EditBuffer_compactJournal (EditBuffer *);
+static int    EditBuffer_checkpointPieces (
+        EditBuffer *,
+        EditBuffer_Piece *,
+        int);
+
+static size_t EditBuffer_Journal_startRecord (
+        EditBuffer_Journal *,
+        EditBuffer_JournalKind,
+        size_t, size_t,
+        size_t, size_t);
+static void   EditBuffer_Journal_endRecord   (EditBuffer_Journal *, size_t);
+static void   EditBuffer_Journal_reserve     (EditBuffer_Journal *, size_t);
+static int    EditBuffer_Journal_writePending (EditBuffer_Journal *, int);
+static void   EditBuffer_Journal_identify    (
+        EditBuffer_JournalHeader *,
+        struct stat *);
+static uint32_t EditBuffer_Journal_checksum  (const char *, size_t);
+static int    EditBuffer_writeAll            (int, const char *, size_t);
+
+/* EditBuffer_openJournal
+ * Sets up the journal for a buffer that was just loaded from file, and replays
+ * the journal left behind from last time, if it was made against the file as
+ * it is now. file can be -1 if the file does not exist. If the buffer has no
+ * file path, it is never journaled.
+ */
+void EditBuffer_openJournal (EditBuffer *editBuffer, int file) {
+        EditBuffer_Journal *journal = &editBuffer->journal;
+        if (editBuffer->filePath[0] == '\0') { return; }
+
+        // the journal for dir/name is dir/.name.journal
+        const char *slash = strrchr(editBuffer->filePath, '/');
+        int directoryLength = 0;
+        if (slash != NULL) {
+                directoryLength = (int)(slash - editBuffer->filePath) + 1;
+        }
+        snprintf (
+                journal->filePath, sizeof(journal->filePath),
+                "%.*s.%s.journal",
+                directoryLength, editBuffer->filePath,
+                editBuffer->filePath + directoryLength);
+
+        struct stat info;
+        if (file < 0 || fstat(file, &info) != 0) {
+                EditBuffer_Journal_identify(&journal->header, NULL);
+        } else {
+                EditBuffer_Journal_identify(&journal->header, &info);
+        }
+        journal->length          = sizeof(EditBuffer_JournalHeader);
+        journal->matchesOriginal = 1;
+        journal->compactedLength = 0;
+
+        int journalFile = open(journal->filePath, O_RDWR);
+        if (journalFile < 0) { return; }
+
+        // a journal from a different version of the file can't be used
+        EditBuffer_JournalHeader header;
+        ssize_t amountRead = pread(journalFile, &header, sizeof(header), 0);
+        if (
+                amountRead != sizeof(header) ||
+                memcmp(&header, &journal->header, sizeof(header)) != 0
+        ) {
+                close(journalFile);
+                unlink(journal->filePath);
+                return;
+        }
+
+        // recovery only ever has to read the journal, however big the file is
+        size_t size = 0;
+        if (fstat(journalFile, &info) == 0) { size = (size_t)(info.st_size); }
+        char *data = malloc(size + 1);
+        size_t dataLength = 0;
+        while (dataLength < size) {
+                amountRead = pread (
+                        journalFile,
+                        data + dataLength,
+                        size - dataLength,
+                        (off_t)(dataLength));
+                if (amountRead <= 0) { break; }
+                dataLength += (size_t)(amountRead);
+        }
+
+        journal->file = journalFile;
+        EditBuffer_replayJournal(editBuffer, data, dataLength);
+        free(data);
+
+        // drop whatever was left over at the end from the editor dying in the
+        // middle of writing it
+        if (ftruncate(journal->file, (off_t)(journal->length)) == 0) {
+                lseek(journal->file, 0, SEEK_END);
+        }
+}
+
+/* EditBuffer_closeJournal
+ * Writes out everything left in the journal of a buffer and closes it. The
+ * journal file itself is left behind, so whatever hasn't been saved can still
+ * be recovered the next time the file is opened.
+ */
+void EditBuffer_closeJournal (EditBuffer *editBuffer) {
+        EditBuffer_Journal *journal = &editBuffer->journal;
+
+        // let the journal catch up with any save in progress first
+        EditBuffer_finishSave(editBuffer);
+        EditBuffer_flushJournal(editBuffer);
+
+        if (journal->file >= 0) { close(journal->file); }
+        free(journal->pending);
+        *journal = (const EditBuffer_Journal) { 0 };
+        journal->file = -1;
+}
+
+/* EditBuffer_flushJournal
+ * Writes out the edits queued up in the journal of a buffer. This should be
+ * called regularly. If a save has finished since the last time, the journal is
+ * started over against the saved file. If the journal has grown too big, it is
+ * compacted.
+ */
+void EditBuffer_flushJournal (EditBuffer *editBuffer) {
+        EditBuffer_Journal *journal = &editBuffer->journal;
+        if (journal->filePath[0] == '\0') { return; }
+
+        if (journal->saving && !EditBuffer_isSaving(editBuffer)) {
+                journal->saving = 0;
+                if (EditBuffer_finishSave(editBuffer) == Error_none) {
+                        EditBuffer_rebaseJournal(editBuffer);
+                }
+        }
+
+        if (!EditBuffer_Journal_writePending(journal, 1)) { return; }
+
+        size_t limit = MAX(Options_journalLimit, journal->compactedLength * 2);
+        if (
+                journal->length > limit &&
+                journal->matchesOriginal &&
+                !journal->saving
+        ) {
+                EditBuffer_compactJournal(editBuffer);
+        }
+}
+
+/* EditBuffer_journalEdit
+ * Queues up an edit to be written to the journal. Insertions must be recorded
+ * after the text has been inserted, since it is read back out of the buffer.
+ */
+void EditBuffer_journalEdit (
+        EditBuffer      *editBuffer,
+        EditBuffer_Edit *edit,
+        int             deleted
+) {
+        EditBuffer_Journal *journal = &editBuffer->journal;
+        if (journal->filePath[0] == '\0' || journal->replaying) { return; }
+
+        if (deleted) {
+                size_t record = EditBuffer_Journal_startRecord (
+                        journal,
+                        EditBuffer_JournalKind_delete,
+                        edit->startRow,  edit->startColumn,
+                        edit->oldEndRow, edit->oldEndColumn);
+                EditBuffer_Journal_endRecord(journal, record);
+                return;
+        }
+
+        size_t record = EditBuffer_Journal_startRecord (
+                journal,
+                EditBuffer_JournalKind_insert,
+                edit->startRow,  edit->startColumn,
+                edit->newEndRow, edit->newEndColumn);
+        EditBuffer_copyText (
+                editBuffer,
+                edit->startColumn,  edit->startRow,
+                edit->newEndColumn, edit->newEndRow,
+                &journal->pending,
+                &journal->pendingLength,
+                &journal->pendingSize);
+        EditBuffer_Journal_endRecord(journal, record);
+}
+
+/* EditBuffer_journalSave
+ * Notes that the buffer was just frozen to be saved. Once the save is done,
+ * everything journaled up until now is in the file.
+ */
+void EditBuffer_journalSave (EditBuffer *editBuffer) {
+        EditBuffer_Journal *journal = &editBuffer->journal;
+        journal->saving    = 1;
+        journal->saveStart = journal->length + journal->pendingLength;
+}
+
+/* EditBuffer_replayJournal
+ * Replays the records in the data of a journal file onto the buffer, stopping
+ * at the first one that is incomplete or damaged. The length of the journal is
+ * set to where it stopped.
+ */
+static void EditBuffer_replayJournal (
+        EditBuffer *editBuffer,
+        const char *data,
+        size_t     length
+) {
+        EditBuffer_Journal *journal = &editBuffer->journal;
+        journal->replaying = 1;
+        journal->length    = EditBuffer_replayRecords (
+                editBuffer,
+                data, sizeof(EditBuffer_JournalHeader),
+                length);
+        journal->replaying = 0;
+
+        // what was recovered can't be undone, since it was never done here.
+        // the file might have been loading in the background, so cursors that
+        // were already placed are kept where the recovered edits moved them.
+        EditBuffer_freeHistory(editBuffer);
+        EditBuffer_cursorsWrangle(editBuffer);
+}
+
+/* EditBuffer_replayRecords
+ * Replays the records in data from index up to length onto the buffer, stopping
+ * at the first one that is incomplete or damaged. Returns where it stopped.
+ */
+static size_t EditBuffer_replayRecords (
+        EditBuffer *editBuffer,
+        const char *data,
+        size_t     index,
+        size_t     length
+) {
+        while (index + sizeof(EditBuffer_JournalRecord) <= length) {
+                EditBuffer_JournalRecord record;
+                memcpy(&record, data + index, sizeof(record));
+
+                size_t available = length - index - sizeof(record);
+                if (record.length > available) { break; }
+
+                size_t recordSize = sizeof(record) + record.length;
+                uint32_t checksum = EditBuffer_Journal_checksum (
+                        data + index + sizeof(record.checksum),
+                        recordSize - sizeof(record.checksum));
+                if (checksum != record.checksum) { break; }
+
+                const char *text = data + index + sizeof(record);
+                if (!EditBuffer_replayRecord(editBuffer, &record, text)) {
+                        break;
+                }
+                index += recordSize;
+        }
+
+        return index;
+}
+
+/* EditBuffer_replayRecord
+ * Replays a single journal record onto the buffer. Returns 0 if the record
+ * doesn't make sense for the buffer as it is, and 1 otherwise.
+ */
+static int EditBuffer_replayRecord (
+        EditBuffer               *editBuffer,
+        EditBuffer_JournalRecord *record,
+        const char               *text
+) {
+        size_t startRow    = (size_t)(record->startRow);
+        size_t startColumn = (size_t)(record->startColumn);
+        size_t endRow      = (size_t)(record->endRow);
+        size_t endColumn   = (size_t)(record->endColumn);
+
+        size_t originalLength = editBuffer->original.lines.amountOfLines;
+
+        switch (record->kind) {
+        case EditBuffer_JournalKind_insert:
+        case EditBuffer_JournalKind_line: {
+                size_t  length = (size_t)(record->length);
+                String *line   = String_new("");
+                String_addValidBytes (
+                        line,
+                        text, length,
+                        Unicode_utf8CountRunes(text, length));
+
+                if (record->kind == EditBuffer_JournalKind_line) {
+                        EditBuffer_placeLine (
+                                editBuffer,
+                                line,
+                                editBuffer->length);
+                        return 1;
+                }
+
+                int valid =
+                        startRow < editBuffer->length &&
+                        startColumn <= EditBuffer_peekLine (
+                                editBuffer,
+                                startRow)->length;
+                if (valid) {
+                        EditBuffer_insertStringAt (
+                                editBuffer,
+                                startColumn, startRow,
+                                line);
+                }
+                String_free(line);
+                return valid;
+        }
+
+        case EditBuffer_JournalKind_delete:
+                if (startRow >= editBuffer->length) { return 0; }
+                EditBuffer_deleteRange (
+                        editBuffer,
+                        startColumn,   startRow,
+                        endColumn - 1, endRow);
+                return 1;
+
+        case EditBuffer_JournalKind_checkpoint:
+                EditBuffer_removeLines(editBuffer, 0, editBuffer->length);
+                return 1;
+
+        case EditBuffer_JournalKind_original:
+                if (
+                        startRow > originalLength ||
+                        endRow > originalLength - startRow
+                ) {
+                        return 0;
+                }
+                EditBuffer_placeOriginal (
+                        editBuffer,
+                        startRow, endRow,
+                        editBuffer->length);
+                return 1;
+
+        default:
+                return 0;
+        }
+}
+
+/* EditBuffer_rebaseJournal
+ * Starts the journal over after a save. Everything journaled before the buffer
+ * was frozen for the save is in the file now, so only what came after it is
+ * kept, under a header for the file as it is now. The buffer is based on the
+ * saved file from then on, so that checkpoints can keep pointing into it.
+ */
+static void EditBuffer_rebaseJournal (EditBuffer *editBuffer) {
+        EditBuffer_Journal *journal = &editBuffer->journal;
+
+        EditBuffer_Original saved = editBuffer->save.saved;
+        editBuffer->save.saved = (const EditBuffer_Original) { 0 };
+
+        // the lines of the original file buffer aren't in the file anymore
+        journal->matchesOriginal = 0;
+        journal->compactedLength = 0;
+
+        struct stat info;
+        if (stat(editBuffer->filePath, &info) == 0) {
+                EditBuffer_Journal_identify(&journal->header, &info);
+        } else {
+                EditBuffer_Journal_identify(&journal->header, NULL);
+        }
+
+        if (!EditBuffer_Journal_writePending(journal, 0)) {
+                EditBuffer_Original_free(&saved);
+                return;
+        }
+
+        // the tail is everything that was journaled after the freeze
+        size_t saveStart = journal->saveStart;
+        size_t length    = 0;
+        char  *tail      = NULL;
+        if (saveStart < journal->length && journal->file >= 0) {
+                length = journal->length - saveStart;
+                tail   = malloc(length);
+                if (pread (
+                        journal->file, tail, length,
+                        (off_t)(saveStart)) != (ssize_t)(length)
+                ) {
+                        free(tail);
+                        EditBuffer_Original_free(&saved);
+                        return;
+                }
+        }
+
+        journal->matchesOriginal = EditBuffer_adoptSaved (
+                editBuffer,
+                &saved,
+                tail, length);
+
+        if (length == 0) {
+                // nothing happened since, so there is nothing to recover
+                if (journal->file >= 0) { close(journal->file); }
+                unlink(journal->filePath);
+                journal->file   = -1;
+                journal->length = sizeof(EditBuffer_JournalHeader);
+                return;
+        }
+
+        char tempPath[PATH_MAX + 8];
+        snprintf(tempPath, sizeof(tempPath), "%s.XXXXXX", journal->filePath);
+        int file = mkstemp(tempPath);
+        if (file < 0) {
+                free(tail);
+                return;
+        }
+
+        int ok = EditBuffer_writeAll (
+                file,
+                (const char *)(&journal->header),
+                sizeof(journal->header));
+        ok = ok && EditBuffer_writeAll(file, tail, length);
+        ok = ok && rename(tempPath, journal->filePath) == 0;
+        free(tail);
+
+        if (!ok) {
+                close(file);
+                unlink(tempPath);
+                return;
+        }
+
+        close(journal->file);
+        journal->file   = file;
+        journal->length = sizeof(EditBuffer_JournalHeader) + length;
+}
+
+/* EditBuffer_adoptSaved
+ * Swaps the file a save just read back in for the original file buffer. The
+ * lines of the saved file are put into a scratch buffer, and the tail of the
+ * journal is replayed onto it, which only takes as long as the tail is. Since
+ * the saved file holds the text of the buffer as it was frozen, the scratch
+ * buffer then has the same text as the buffer, and its pieces are swapped in.
+ * Returns 1 if this worked, and 0 if the buffer was left alone. saved is used
+ * up either way.
+ */
+static int EditBuffer_adoptSaved (
+        EditBuffer          *editBuffer,
+        EditBuffer_Original *saved,
+        const char          *tail,
+        size_t              length
+) {
+        // the file might have been replaced by something else since it was
+        // read back, in which case its lines aren't the ones in the journal
+        struct stat info;
+        if (
+                saved->lines.amountOfLines == 0 ||
+                stat(editBuffer->filePath, &info) != 0 ||
+                info.st_dev != saved->device ||
+                info.st_ino != saved->inode
+        ) {
+                EditBuffer_Original_free(saved);
+                return 0;
+        }
+
+        EditBuffer *scratch = EditBuffer_new();
+        scratch->original = *saved;
+        EditBuffer_placeOriginal (
+                scratch,
+                0, saved->lines.amountOfLines,
+                0);
+
+        int adopted =
+                EditBuffer_replayRecords(scratch, tail, 0, length) == length &&
+                scratch->length == editBuffer->length;
+        if (adopted) {
+                EditBuffer_Piece   *pieces   = editBuffer->pieces;
+                EditBuffer_Original original = editBuffer->original;
+                editBuffer->pieces   = scratch->pieces;
+                editBuffer->original = scratch->original;
+                scratch->pieces      = pieces;
+                scratch->original    = original;
+        }
+
+        // the scratch buffer takes whatever isn't used anymore with it
+        EditBuffer_free(scratch);
+        return adopted;
+}
+
+/* EditBuffer_compactJournal
+ * Replaces the journal with a checkpoint of the buffer as it is now. Runs of
+ * lines that are still the same as in the original file buffer only take up a
+ * single record, so the checkpoint is about as big as the edited lines are.
+ */
+static void EditBuffer_compactJournal (EditBuffer *editBuffer) {
+        EditBuffer_Journal *journal = &editBuffer->journal;
+
+        char tempPath[PATH_MAX + 8];
+        snprintf(tempPath, sizeof(tempPath), "%s.XXXXXX", journal->filePath);
+        int file = mkstemp(tempPath);
+        if (file < 0) { return; }
+
+        // the pending queue is empty right now, so it can be borrowed to put
+        // the checkpoint together
+        EditBuffer_Journal_reserve(journal, sizeof(journal->header));
+        memcpy(journal->pending, &journal->header, sizeof(journal->header));
+        journal->pendingLength = sizeof(journal->header);
+
+        size_t record = EditBuffer_Journal_startRecord (
+                journal,
+                EditBuffer_JournalKind_checkpoint,
+                0, 0, 0, 0);
+        EditBuffer_Journal_endRecord(journal, record);
+
+        int ok = EditBuffer_checkpointPieces (
+                editBuffer,
+                editBuffer->pieces,
+                file);
+        ok = ok && EditBuffer_writeAll (
+                file,
+                journal->pending,
+                journal->pendingLength);
+        ok = ok && fsync(file) == 0;
+        ok = ok && rename(tempPath, journal->filePath) == 0;
+
+        journal->pendingLength = 0;
+        if (!ok) {
+                close(file);
+                unlink(tempPath);
+                return;
+        }
+
+        if (journal->file >= 0) { close(journal->file); }
+        journal->file            = file;
+        journal->length          = (size_t)(lseek(file, 0, SEEK_END));
+        journal->compactedLength = journal->length;
+}
+
+/* EditBuffer_checkpointPieces
+ * Adds a record for every piece in a tree to the pending queue of the journal,
+ * in order, writing the queue out to file whenever it gets big. Returns 1 if
+ * everything was written, and 0 if something went wrong.
+ */
+static int EditBuffer_checkpointPieces (
+        EditBuffer       *editBuffer,
+        EditBuffer_Piece *piece,
+        int              file
+) {
+        if (piece == NULL) { return 1; }
+        EditBuffer_Journal *journal = &editBuffer->journal;
+
+        if (!EditBuffer_checkpointPieces(editBuffer, piece->left, file)) {
+                return 0;
+        }
+
+        size_t record;
+        if (piece->line == NULL) {
+                record = EditBuffer_Journal_startRecord (
+                        journal,
+                        EditBuffer_JournalKind_original,
+                        piece->start, 0,
+                        piece->length, 0);
+        } else {
+                record = EditBuffer_Journal_startRecord (
+                        journal,
+                        EditBuffer_JournalKind_line,
+                        0, 0, 0, 0);
+                EditBuffer_Journal_reserve(journal, piece->line->byteLength);
+                memcpy (
+                        journal->pending + journal->pendingLength,
+                        piece->line->buffer,
+                        piece->line->byteLength);
+                journal->pendingLength += piece->line->byteLength;
+        }
+        EditBuffer_Journal_endRecord(journal, record);
+
+        if (journal->pendingLength >= JOURNAL_CHUNK_SIZE) {
+                if (!EditBuffer_writeAll (
+                        file,
+                        journal->pending,
+                        journal->pendingLength)
+                ) {
+                        return 0;
+                }
+                journal->pendingLength = 0;
+        }
+
+        return EditBuffer_checkpointPieces(editBuffer, piece->right, file);
+}
+
+/* EditBuffer_Journal_startRecord
+ * Starts a new record on the end of the pending queue of a journal, and returns
+ * where it starts. Any text for the record should be added right after this,
+ * and then the record finished with EditBuffer_Journal_endRecord.
+ */
+static size_t EditBuffer_Journal_startRecord (
+        EditBuffer_Journal     *journal,
+        EditBuffer_JournalKind kind,
+        size_t startRow, size_t startColumn,
+        size_t endRow,   size_t endColumn
+) {
+        EditBuffer_JournalRecord record = {
+                .kind        = (uint32_t)(kind),
+                .startRow    = startRow,
+                .startColumn = startColumn,
+                .endRow      = endRow,
+                .endColumn   = endColumn,
+        };
+
+        size_t start = journal->pendingLength;
+        EditBuffer_Journal_reserve(journal, sizeof(record));
+        memcpy(journal->pending + start, &record, sizeof(record));
+        journal->pendingLength += sizeof(record);
+        return start;
+}
+
+/* EditBuffer_Journal_endRecord
+ * Finishes the record that starts at start in the pending queue of a journal,
+ * filling in the length of its text and its checksum.
+ */
+static void EditBuffer_Journal_endRecord (
+        EditBuffer_Journal *journal,
+        size_t start
+) {
+        EditBuffer_JournalRecord record;
+        memcpy(&record, journal->pending + start, sizeof(record));
+        record.length =
+                (uint64_t)(journal->pendingLength - start - sizeof(record));
+        memcpy(journal->pending + start, &record, sizeof(record));
+
+        record.checksum = EditBuffer_Journal_checksum (
+                journal->pending + start + sizeof(record.checksum),
+                journal->pendingLength - start - sizeof(record.checksum));
+        memcpy(journal->pending + start, &record, sizeof(record));
+}
+
+/* EditBuffer_Journal_reserve
+ * Makes sure there is room for amount more bytes in the pending queue of a
+ * journal.
+ */
+static void EditBuffer_Journal_reserve (
+        EditBuffer_Journal *journal,
+        size_t amount
+) {
+        size_t needed = journal->pendingLength + amount;
+        if (needed <= journal->pendingSize) { return; }
+
+        journal->pendingSize = MAX(MAX(journal->pendingSize * 2, needed), 256);
+        journal->pending = realloc(journal->pending, journal->pendingSize);
+}
+
+/* EditBuffer_Journal_writePending
+ * Writes the pending queue of a journal out to its file, making the file first
+ * if there isn't one yet. If shrink is set and the queue has grown big, its
+ * memory is given back. Returns 1 if everything was written, and 0 otherwise.
+ */
+static int EditBuffer_Journal_writePending (
+        EditBuffer_Journal *journal,
+        int shrink
+) {
+        if (journal->pendingLength == 0) { return 1; }
+
+        if (journal->file < 0) {
+                journal->file = open (
+                        journal->filePath,
+                        O_RDWR | O_CREAT | O_TRUNC,
+                        0600);
+                if (journal->file < 0) { return 0; }
+
+                if (!EditBuffer_writeAll (
+                        journal->file,
+                        (const char *)(&journal->header),
+                        sizeof(journal->header))
+                ) {
+                        close(journal->file);
+                        unlink(journal->filePath);
+                        journal->file = -1;
+                        return 0;
+                }
+        }
+
+        if (!EditBuffer_writeAll (
+                journal->file,
+                journal->pending,
+                journal->pendingLength)
+        ) {
+                return 0;
+        }
+
+        journal->length       += journal->pendingLength;
+        journal->pendingLength = 0;
+
+        if (shrink && journal->pendingSize > JOURNAL_CHUNK_SIZE) {
+                free(journal->pending);
+                journal->pending     = NULL;
+                journal->pendingSize = 0;
+        }
+        return 1;
+}
+
+/* EditBuffer_Journal_identify
+ * Fills in a journal header for the file described by info. If info is NULL,
+ * the header is for a file that does not exist.
+ */
+static void EditBuffer_Journal_identify (
+        EditBuffer_JournalHeader *header,
+        struct stat              *info
+) {
+        *header = (const EditBuffer_JournalHeader) { 0 };
+        memcpy(header->magic, JOURNAL_MAGIC, sizeof(header->magic));
+        if (info == NULL) { return; }
+
+        header->device              = (uint64_t)(info->st_dev);
+        header->inode               = (uint64_t)(info->st_ino);
+        header->size                = (uint64_t)(info->st_size);
+        header->modifiedSeconds     = (uint64_t)(info->st_mtim.tv_sec);
+        header->modifiedNanoseconds = (uint64_t)(info->st_mtim.tv_nsec);
+}
+
+/* EditBuffer_Journal_checksum
+ * Returns the FNV-1a hash of length bytes of data.
+ */
+static uint32_t EditBuffer_Journal_checksum (const char *data, size_t length) {
+        uint32_t hash = 2166136261u;
+        for (size_t index = 0; index < length; index ++) {
+                hash ^= (uint8_t)(data[index]);
+                hash *= 16777619u;
+        }
+        return hash;
+}
+
+/* EditBuffer_writeAll
+ * Writes all length bytes of buffer to file. Returns 1 if everything was
+ * written, and 0 if something went wrong.
+ */
+static int EditBuffer_writeAll (int file, const char *buffer, size_t length) {
+        while (length > 0) {
+                ssize_t written = write(file, buffer, length);
+                if (written < 0 && errno == EINTR) { continue; }
+                if (written <= 0)                  { return 0; }
+
+                buffer += written;
+                length -= (size_t)(written);
+        }
+        return 1;
+}
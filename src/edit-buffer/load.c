@@ -0,0 +1,168 @@
+#include <unistd.h>
+
+#include "module.h"
+
+// how much of a file is indexed right away when it is opened. this is a lot
+// more than fits on any screen, but still only takes a moment.
+#define LOAD_PREVIEW_SIZE (256 * 1024)
+// files that have less than this left after the preview are indexed all at once
+#define LOAD_BACKGROUND_MINIMUM (4 * 1024 * 1024)
+// read only buffers keep the start of one out of every this many lines
+#define LOAD_SPARSE_STRIDE 4096
+
+static void *EditBuffer_Load_run (void *);
+static void  EditBuffer_Load_add (EditBuffer *);
+
+/* EditBuffer_startLoad
+ * Indexes the start of each line in the original file buffer, and returns how
+ * many of its lines are ready to be put into the buffer. If the file is big,
+ * only the lines up to a bit past LOAD_PREVIEW_SIZE bytes are indexed right
+ * away, and the rest is left to a worker thread. Read only buffers get a sparse
+ * index, so that the memory it takes up stays small no matter how big the file
+ * is.
+ */
+size_t EditBuffer_startLoad (EditBuffer *editBuffer) {
+        EditBuffer_Original *original = &editBuffer->original;
+        EditBuffer_Load     *load     = &editBuffer->load;
+
+        size_t stride = 1;
+        if (editBuffer->readOnly) { stride = LOAD_SPARSE_STRIDE; }
+        original->lines = EditBuffer_LineIndex_new(stride);
+
+        // the preview ends with the line that reaches past LOAD_PREVIEW_SIZE,
+        // so it is always made of whole lines
+        size_t previewEnd = original->size;
+        if (original->size > LOAD_PREVIEW_SIZE + LOAD_BACKGROUND_MINIMUM) {
+                const char *lineBreak = memchr (
+                        original->data + LOAD_PREVIEW_SIZE, '\n',
+                        original->size - LOAD_PREVIEW_SIZE);
+                if (lineBreak != NULL) {
+                        previewEnd = (size_t)(lineBreak - original->data) + 1;
+                }
+        }
+
+        EditBuffer_indexLines (
+                original->data, 0, previewEnd,
+                &original->lines);
+        if (previewEnd == original->size) {
+                return original->lines.amountOfLines;
+        }
+
+        // the worker thread starts off with a copy of what was found so far,
+        // so that its index can just be swapped in once it is done
+        load->start = previewEnd;
+        load->lines = EditBuffer_LineIndex_copy(&original->lines);
+
+        atomic_store(&load->finished, 0);
+        if (pthread_create (
+                &load->thread, NULL,
+                EditBuffer_Load_run, editBuffer
+        )) {
+                // if there is no thread to do it on, just do it here
+                EditBuffer_Load_run(editBuffer);
+                EditBuffer_LineIndex_free(&original->lines);
+                original->lines = load->lines;
+                load->lines     = (const EditBuffer_LineIndex) { 0 };
+                return original->lines.amountOfLines;
+        }
+
+        // the last line start found belongs to a line that hasn't been
+        // indexed to the end yet, so it is left out until it has been
+        load->running = 1;
+        return original->lines.amountOfLines - 1;
+}
+
+/* EditBuffer_finishLoad
+ * Waits for the rest of the file to be indexed, if it is still being loaded,
+ * and adds its lines onto the end of the buffer. Any unsaved work found in the
+ * journal of the file is then put back. This should only be called once
+ * EditBuffer_isLoading returns 0, so that it doesn't block.
+ */
+void EditBuffer_finishLoad (EditBuffer *editBuffer) {
+        EditBuffer_Load *load = &editBuffer->load;
+
+        if (load->running) {
+                pthread_join(load->thread, NULL);
+                load->running = 0;
+                EditBuffer_Load_add(editBuffer);
+        }
+
+        if (load->file >= 0) {
+                EditBuffer_openJournal(editBuffer, load->file);
+                close(load->file);
+                load->file = -1;
+        }
+}
+
+/* EditBuffer_isLoaded
+ * Returns 1 once the whole file has been added to the buffer by
+ * EditBuffer_finishLoad, along with any unsaved work from its journal. Until
+ * then, the buffer can't be edited or saved.
+ */
+int EditBuffer_isLoaded (EditBuffer *editBuffer) {
+        EditBuffer_Load *load = &editBuffer->load;
+        return !load->running && load->file < 0;
+}
+
+/* EditBuffer_isLoading
+ * Returns 1 if the rest of the file is still being indexed, and 0 if it isn't.
+ * Once this returns 0, EditBuffer_finishLoad will not block.
+ */
+int EditBuffer_isLoading (EditBuffer *editBuffer) {
+        EditBuffer_Load *load = &editBuffer->load;
+        return load->running && !atomic_load(&load->finished);
+}
+
+/* EditBuffer_stopLoad
+ * Waits for the worker thread to stop, if the file is still being loaded, and
+ * throws away whatever it found without adding it to the buffer.
+ */
+void EditBuffer_stopLoad (EditBuffer *editBuffer) {
+        EditBuffer_Load *load = &editBuffer->load;
+
+        if (load->running) {
+                pthread_join(load->thread, NULL);
+                load->running = 0;
+        }
+        if (load->file >= 0) { close(load->file); }
+
+        EditBuffer_LineIndex_free(&load->lines);
+        load->file = -1;
+}
+
+/* EditBuffer_Load_run
+ * The worker thread that indexes the rest of a file. This only ever reads the
+ * original file buffer, which doesn't change while the file is loading.
+ */
+static void *EditBuffer_Load_run (void *argument) {
+        EditBuffer      *editBuffer = argument;
+        EditBuffer_Load *load       = &editBuffer->load;
+
+        EditBuffer_indexLines (
+                editBuffer->original.data,
+                load->start, editBuffer->original.size,
+                &load->lines);
+
+        atomic_store(&load->finished, 1);
+        EditBuffer_notifyWorkerFinish();
+        return NULL;
+}
+
+/* EditBuffer_Load_add
+ * Swaps in the index made by the worker thread, and adds every line that wasn't
+ * in the buffer yet onto the end of it.
+ */
+static void EditBuffer_Load_add (EditBuffer *editBuffer) {
+        EditBuffer_Original *original = &editBuffer->original;
+        EditBuffer_Load     *load     = &editBuffer->load;
+
+        size_t start = original->lines.amountOfLines - 1;
+        EditBuffer_LineIndex_free(&original->lines);
+        original->lines = load->lines;
+        load->lines     = (const EditBuffer_LineIndex) { 0 };
+
+        EditBuffer_placeOriginal (
+                editBuffer,
+                start, original->lines.amountOfLines - start,
+                editBuffer->length);
+}
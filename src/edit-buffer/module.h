@@ -12,23 +12,73 @@
                 index ++                              \
         ) {                                            \
                 EditBuffer_Cursor *cursor = editBuffer->cursors + index;
-#define START_ALL_CURSORS_BATCH_OPERATION START_ALL_CURSORS \
-        editBuffer->dontMerge = 1;
-
 #define END_ALL_CURSORS }
+
+// batch operations go through the cursors from last to first. see
+// EditBuffer_startBatch.
+#define START_ALL_CURSORS_BATCH_OPERATION                \
+        EditBuffer_startBatch(editBuffer);                \
+        for (                                              \
+                size_t index = editBuffer->amountOfCursors; \
+                index --> 0;                                 \
+        ) {                                                   \
+                EditBuffer_Cursor *cursor =                    \
+                        EditBuffer_startBatchCursor(editBuffer, index);
 #define END_ALL_CURSORS_BATCH_OPERATION END_ALL_CURSORS \
-        editBuffer->dontMerge = 0;
+        EditBuffer_endBatch(editBuffer);
+
+/* EditBuffer_Shift
+ * Shifts positions from column and row onward by a number of rows. Positions on
+ * that row are also shifted by a number of columns. The amounts are stored as
+ * sizes, and wrap around to move things backwards.
+ */
+typedef struct {
+        size_t column;
+        size_t row;
+        size_t columns;
+        size_t rows;
+} EditBuffer_Shift;
 
 void EditBuffer_placeLine      (EditBuffer *, String *, size_t);
-void EditBuffer_realloc        (EditBuffer *, size_t);
-void EditBuffer_shiftDown      (EditBuffer *, size_t, size_t);
-void EditBuffer_shiftUp        (EditBuffer *, size_t, size_t, int);
-void EditBuffer_shiftCursorsInLineAfter (
+void EditBuffer_placeLines     (EditBuffer *, String **, size_t, size_t);
+void EditBuffer_placeOriginal  (EditBuffer *, size_t, size_t, size_t);
+void EditBuffer_removeLines    (EditBuffer *, size_t, size_t);
+void EditBuffer_loadOriginal   (EditBuffer *, int);
+void EditBuffer_Original_open  (EditBuffer_Original *, int);
+void EditBuffer_Original_free  (EditBuffer_Original *);
+void EditBuffer_indexLines (
+        const char *,
+        size_t, size_t,
+        EditBuffer_LineIndex *);
+EditBuffer_LineIndex EditBuffer_LineIndex_new  (size_t);
+EditBuffer_LineIndex EditBuffer_LineIndex_copy (EditBuffer_LineIndex *);
+void                 EditBuffer_LineIndex_free (EditBuffer_LineIndex *);
+size_t EditBuffer_startLoad    (EditBuffer *);
+void EditBuffer_stopLoad       (EditBuffer *);
+int  EditBuffer_isLoaded       (EditBuffer *);
+Error EditBuffer_startFollow   (EditBuffer *);
+void EditBuffer_stopFollow     (EditBuffer *);
+void EditBuffer_notifyWorkerFinish (void);
+void EditBuffer_freePieces     (EditBuffer *);
+void EditBuffer_markChanged    (EditBuffer *, size_t, size_t, size_t);
+void EditBuffer_shiftCursors    (EditBuffer *, EditBuffer_Edit *);
+void EditBuffer_recordInsertion (EditBuffer *, EditBuffer_Edit *);
+void EditBuffer_recordDeletion  (EditBuffer *, EditBuffer_Edit *);
+void EditBuffer_freeHistory    (EditBuffer *);
+void EditBuffer_copyText (
         EditBuffer *,
         size_t, size_t,
-        int);
+        size_t, size_t,
+        char **, size_t *, size_t *);
+void EditBuffer_openJournal    (EditBuffer *, int);
+void EditBuffer_closeJournal   (EditBuffer *);
+void EditBuffer_journalEdit    (EditBuffer *, EditBuffer_Edit *, int);
+void EditBuffer_journalSave    (EditBuffer *);
+void EditBuffer_startBatch     (EditBuffer *);
+void EditBuffer_endBatch       (EditBuffer *);
 void EditBuffer_mergeCursors   (EditBuffer *);
 void EditBuffer_cursorsWrangle (EditBuffer *);
+EditBuffer_Cursor *EditBuffer_startBatchCursor (EditBuffer *, size_t);
 void EditBuffer_Cursor_wrangle (EditBuffer_Cursor *);
 
 void EditBuffer_Cursor_predictMovement (
@@ -0,0 +1,739 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "module.h"
+
+// files smaller than this are read into memory instead of being mapped. this
+// takes next to no time for them, and then nothing done to the file on disk can
+// affect the buffer.
+#define ORIGINAL_MAP_MINIMUM (4 * 1024 * 1024)
+
+// the size of a page of memory, found once mappings are first guarded
+static uintptr_t pageSize = 0;
+
+// a range of memory that a file was mapped into. these are kept in a list that
+// is only ever added onto, so that the SIGBUS handler can look through it from
+// any thread without taking a lock. ranges that are unmapped are emptied out,
+// and reused for the next file that is mapped. files are mapped by saves too,
+// so changes to the list are made while holding mappingsLock.
+typedef struct EditBuffer_Mapping EditBuffer_Mapping;
+struct EditBuffer_Mapping {
+        _Atomic uintptr_t   start;
+        _Atomic uintptr_t   end;
+        EditBuffer_Mapping *next;
+};
+
+static EditBuffer_Mapping *_Atomic mappings     = NULL;
+static pthread_mutex_t             mappingsLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t              guardOnce    = PTHREAD_ONCE_INIT;
+
+static EditBuffer_Piece *EditBuffer_Piece_new (size_t, size_t, String *);
+static void              EditBuffer_Piece_free   (EditBuffer_Piece *);
+static void              EditBuffer_Piece_update (EditBuffer_Piece *);
+static EditBuffer_Piece *EditBuffer_Piece_merge  (
+        EditBuffer_Piece *,
+        EditBuffer_Piece *);
+static void              EditBuffer_Piece_split  (
+        EditBuffer_Piece *,
+        size_t,
+        EditBuffer_Piece **, EditBuffer_Piece **);
+static EditBuffer_Piece *EditBuffer_Piece_find   (
+        EditBuffer_Piece *,
+        size_t,
+        size_t *);
+static EditBuffer_Piece *EditBuffer_Piece_build  (String **, size_t);
+
+static String *EditBuffer_materializeLine (EditBuffer *, size_t);
+static void    EditBuffer_decodeLine      (EditBuffer *, size_t, String *);
+static size_t  EditBuffer_findLineStart   (EditBuffer *, size_t);
+static void    EditBuffer_readOriginal    (EditBuffer_Original *, int);
+static void    EditBuffer_guardMappings   (void);
+static void    EditBuffer_installGuard    (void);
+static void    EditBuffer_addMapping      (void *, size_t);
+static void    EditBuffer_removeMapping   (void *);
+static void    EditBuffer_catchCutShort   (int, siginfo_t *, void *);
+static void    EditBuffer_updateLength    (EditBuffer *);
+
+/* EditBuffer_getLine
+ * Returns the line at row. If it does not exist, this function returns NULL. If
+ * the line has not been touched since the file was loaded, it is decoded from
+ * the original file buffer first. Since the line is returned so that it can be
+ * modified, it is marked as changed.
+ */
+String *EditBuffer_getLine (EditBuffer *editBuffer, size_t row) {
+        if (row >= editBuffer->length) { return NULL; }
+        EditBuffer_markChanged(editBuffer, row, row + 1, row + 1);
+
+        size_t offset;
+        EditBuffer_Piece *piece = EditBuffer_Piece_find (
+                editBuffer->pieces,
+                row, &offset);
+
+        if (piece->line != NULL) { return piece->line; }
+        return EditBuffer_materializeLine(editBuffer, row);
+}
+
+/* EditBuffer_peekLine
+ * Returns the line at row for reading only. If it does not exist, this function
+ * returns NULL. Untouched lines are decoded into a scratch string instead of
+ * being split off into their own piece, so the returned string must not be
+ * modified, and is only valid until the next call to this function.
+ */
+String *EditBuffer_peekLine (EditBuffer *editBuffer, size_t row) {
+        if (row >= editBuffer->length) { return NULL; }
+
+        size_t offset;
+        EditBuffer_Piece *piece = EditBuffer_Piece_find (
+                editBuffer->pieces,
+                row, &offset);
+
+        if (piece->line != NULL) { return piece->line; }
+
+        if (editBuffer->peekedLine == NULL) {
+                editBuffer->peekedLine = String_new("");
+        } else {
+                String_clear(editBuffer->peekedLine);
+        }
+
+        EditBuffer_decodeLine (
+                editBuffer,
+                piece->start + offset,
+                editBuffer->peekedLine);
+        return editBuffer->peekedLine;
+}
+
+/* EditBuffer_placeLine
+ * Inserts a line at the specified index, moving all lines after it downwards.
+ * The edit buffer takes ownership of the line.
+ */
+void EditBuffer_placeLine (
+        EditBuffer *editBuffer,
+        String     *line,
+        size_t     index
+) {
+        EditBuffer_Piece *before;
+        EditBuffer_Piece *after;
+        EditBuffer_Piece_split(editBuffer->pieces, index, &before, &after);
+
+        EditBuffer_Piece *piece = EditBuffer_Piece_new(0, 1, line);
+        editBuffer->pieces = EditBuffer_Piece_merge (
+                EditBuffer_Piece_merge(before, piece),
+                after);
+
+        EditBuffer_updateLength(editBuffer);
+        EditBuffer_markChanged(editBuffer, index, index, index + 1);
+}
+
+/* EditBuffer_placeLines
+ * Inserts amount lines at the specified index, moving all lines after them
+ * downwards. The lines are built into a tree of their own first, so that they
+ * can be spliced in all at once. The edit buffer takes ownership of the lines,
+ * but not of the array holding them.
+ */
+void EditBuffer_placeLines (
+        EditBuffer *editBuffer,
+        String     **lines,
+        size_t     amount,
+        size_t     index
+) {
+        if (amount == 0) { return; }
+
+        EditBuffer_Piece *before;
+        EditBuffer_Piece *after;
+        EditBuffer_Piece_split(editBuffer->pieces, index, &before, &after);
+
+        EditBuffer_Piece *pieces = EditBuffer_Piece_build(lines, amount);
+        editBuffer->pieces = EditBuffer_Piece_merge (
+                EditBuffer_Piece_merge(before, pieces),
+                after);
+
+        EditBuffer_updateLength(editBuffer);
+        EditBuffer_markChanged(editBuffer, index, index, index + amount);
+}
+
+/* EditBuffer_placeOriginal
+ * Inserts amount lines of the original file buffer, starting at start, at the
+ * specified index, moving all lines after them downwards. The lines are not
+ * decoded until they are needed.
+ */
+void EditBuffer_placeOriginal (
+        EditBuffer *editBuffer,
+        size_t     start,
+        size_t     amount,
+        size_t     index
+) {
+        if (amount == 0) { return; }
+
+        EditBuffer_Piece *before;
+        EditBuffer_Piece *after;
+        EditBuffer_Piece_split(editBuffer->pieces, index, &before, &after);
+
+        EditBuffer_Piece *piece = EditBuffer_Piece_new(start, amount, NULL);
+        editBuffer->pieces = EditBuffer_Piece_merge (
+                EditBuffer_Piece_merge(before, piece),
+                after);
+
+        EditBuffer_updateLength(editBuffer);
+        EditBuffer_markChanged(editBuffer, index, index, index + amount);
+}
+
+/* EditBuffer_removeLines
+ * Removes and frees amount lines starting at location, moving all lines after
+ * them upwards.
+ */
+void EditBuffer_removeLines (
+        EditBuffer *editBuffer,
+        size_t     location,
+        size_t     amount
+) {
+        if (amount == 0) { return; }
+
+        EditBuffer_Piece *before;
+        EditBuffer_Piece *removed;
+        EditBuffer_Piece *after;
+        EditBuffer_Piece_split(editBuffer->pieces, location, &before, &after);
+        EditBuffer_Piece_split(after, amount, &removed, &after);
+
+        EditBuffer_Piece_free(removed);
+        editBuffer->pieces = EditBuffer_Piece_merge(before, after);
+
+        EditBuffer_updateLength(editBuffer);
+        EditBuffer_markChanged (
+                editBuffer,
+                location, location + amount,
+                location);
+}
+
+/* EditBuffer_loadOriginal
+ * Opens the file as the original file buffer, and starts indexing the start of
+ * each line. Nothing else is decoded up front. The edit buffer is then made to
+ * span every line of it that has been indexed so far. See EditBuffer_startLoad.
+ * The edit buffer must be empty before calling this function.
+ */
+void EditBuffer_loadOriginal (EditBuffer *editBuffer, int file) {
+        // followed files are mapped too, so following a huge log doesn't read
+        // all of it into memory first. if it is cut short later on, the
+        // buffer is started over by EditBuffer_updateFollow.
+        EditBuffer_Original_open(&editBuffer->original, file);
+
+        size_t amountOfLines = EditBuffer_startLoad(editBuffer);
+        editBuffer->pieces = EditBuffer_Piece_new(0, amountOfLines, NULL);
+        EditBuffer_updateLength(editBuffer);
+}
+
+/* EditBuffer_Original_open
+ * Maps file into memory as the contents of original, without indexing it. If
+ * the file is small, or cannot be mapped (for example, if it is a pipe), it is
+ * read into memory instead. This can be called from any thread.
+ *
+ * Even though the mapping is private, whatever is written to the file on disk
+ * by something else still shows up in it, since pages are only copied once they
+ * are written to, and the mapping is never written to. If the file is cut short
+ * on disk, the part of the mapping past its new end reads as zero bytes instead
+ * of crashing the editor. See EditBuffer_guardMappings.
+ */
+void EditBuffer_Original_open (EditBuffer_Original *original, int file) {
+        struct stat info;
+        if (fstat(file, &info) != 0) {
+                EditBuffer_readOriginal(original, file);
+                return;
+        }
+        original->device = info.st_dev;
+        original->inode  = info.st_ino;
+
+        if (S_ISREG(info.st_mode) && info.st_size >= ORIGINAL_MAP_MINIMUM) {
+                EditBuffer_guardMappings();
+                void *data = mmap (
+                        NULL, (size_t)(info.st_size),
+                        PROT_READ, MAP_PRIVATE,
+                        file, 0);
+                if (data != MAP_FAILED) {
+                        EditBuffer_addMapping(data, (size_t)(info.st_size));
+                        original->data   = data;
+                        original->size   = (size_t)(info.st_size);
+                        original->mapped = 1;
+                        return;
+                }
+        }
+
+        EditBuffer_readOriginal(original, file);
+}
+
+/* EditBuffer_Original_free
+ * Frees the contents of an original file buffer, along with its index.
+ */
+void EditBuffer_Original_free (EditBuffer_Original *original) {
+        if (original->mapped) {
+                EditBuffer_removeMapping(original->data);
+                munmap(original->data, original->size);
+        } else {
+                free(original->data);
+        }
+        EditBuffer_LineIndex_free(&original->lines);
+        *original = (const EditBuffer_Original) { 0 };
+}
+
+/* EditBuffer_freePieces
+ * Frees the piece tree, every line in it, and the original file buffer.
+ */
+void EditBuffer_freePieces (EditBuffer *editBuffer) {
+        EditBuffer_Piece_free(editBuffer->pieces);
+        if (editBuffer->peekedLine != NULL) {
+                String_free(editBuffer->peekedLine);
+        }
+        EditBuffer_Original_free(&editBuffer->original);
+
+        editBuffer->pieces     = NULL;
+        editBuffer->peekedLine = NULL;
+        editBuffer->length     = 0;
+}
+
+/* EditBuffer_materializeLine
+ * Decodes the line at row from the original file buffer into a String, and
+ * splits it off into its own piece so it can be edited.
+ */
+static String *EditBuffer_materializeLine (EditBuffer *editBuffer, size_t row) {
+        EditBuffer_Piece *before;
+        EditBuffer_Piece *piece;
+        EditBuffer_Piece *after;
+        EditBuffer_Piece_split(editBuffer->pieces, row, &before, &after);
+        EditBuffer_Piece_split(after, 1, &piece, &after);
+
+        // the split off piece still has the priority of the run it came from,
+        // so it is replaced with a new one. otherwise, lines that are touched
+        // one after another would pile up into a long chain.
+        EditBuffer_Piece *run = piece;
+        piece = EditBuffer_Piece_new(run->start, 1, String_new(""));
+        EditBuffer_Piece_free(run);
+        EditBuffer_decodeLine(editBuffer, piece->start, piece->line);
+
+        editBuffer->pieces = EditBuffer_Piece_merge (
+                EditBuffer_Piece_merge(before, piece),
+                after);
+        return piece->line;
+}
+
+/* EditBuffer_decodeLine
+ * Decodes a line of the original file buffer, and appends it to destination.
+ * The line ends right before the next line break, or at the end of the file if
+ * it is the last one.
+ */
+static void EditBuffer_decodeLine (
+        EditBuffer *editBuffer,
+        size_t     index,
+        String     *destination
+) {
+        EditBuffer_Original  *original = &editBuffer->original;
+        EditBuffer_LineIndex *lines    = &original->lines;
+
+        if (lines->rows == NULL) {
+                size_t start = lines->starts[index];
+                size_t end   = original->size;
+                if (index + 1 < lines->amountOfLines) {
+                        end = lines->starts[index + 1] - 1;
+                }
+
+                String_addBytes (
+                        destination,
+                        original->data + start,
+                        end - start);
+                return;
+        }
+
+        size_t start = EditBuffer_findLineStart(editBuffer, index);
+        const char *lineBreak = memchr (
+                original->data + start, '\n',
+                original->size - start);
+
+        size_t end = original->size;
+        if (lineBreak != NULL) { end = (size_t)(lineBreak - original->data); }
+        String_addBytes(destination, original->data + start, end - start);
+}
+
+/* EditBuffer_findLineStart
+ * Finds the start of a line of the original file buffer using a sparse index.
+ * The closest line before it that is in the index is looked up, or the line
+ * that was found last time if that is closer, and then line breaks are skipped
+ * over until the line is reached.
+ */
+static size_t EditBuffer_findLineStart (EditBuffer *editBuffer, size_t index) {
+        EditBuffer_Original  *original = &editBuffer->original;
+        EditBuffer_LineIndex *lines    = &original->lines;
+
+        // find the last line in the index that is at or before this one
+        size_t low  = 0;
+        size_t high = lines->amountOfStarts;
+        while (high - low > 1) {
+                size_t middle = low + (high - low) / 2;
+                if (lines->rows[middle] <= index) {
+                        low = middle;
+                } else {
+                        high = middle;
+                }
+        }
+
+        size_t row   = lines->rows[low];
+        size_t start = lines->starts[low];
+        if (original->hintRow <= index && original->hintRow > row) {
+                row   = original->hintRow;
+                start = original->hintStart;
+        }
+
+        for (; row < index; row ++) {
+                const char *lineBreak = memchr (
+                        original->data + start, '\n',
+                        original->size - start);
+                if (lineBreak == NULL) { break; }
+                start = (size_t)(lineBreak - original->data) + 1;
+        }
+
+        original->hintRow   = row;
+        original->hintStart = start;
+        return start;
+}
+
+/* EditBuffer_guardMappings
+ * Makes sure that reading past the end of a file that was cut short on disk
+ * after being mapped doesn't crash the editor. Normally, this raises SIGBUS.
+ * The first time this is called, a handler is set up for it which maps a page
+ * of zero bytes over the page that couldn't be read, so that reading it again
+ * works. This is only done for ranges added with EditBuffer_addMapping.
+ * EditBuffer_save refuses to write a buffer out if this might have
+ * happened to it, since the zeros would be saved in place of the lost text.
+ */
+static void EditBuffer_guardMappings (void) {
+        pthread_once(&guardOnce, EditBuffer_installGuard);
+}
+
+/* EditBuffer_installGuard
+ * Sets up the SIGBUS handler for EditBuffer_guardMappings. This is only ever
+ * called once.
+ */
+static void EditBuffer_installGuard (void) {
+        pageSize = (uintptr_t)(sysconf(_SC_PAGESIZE));
+
+        struct sigaction action = { 0 };
+        action.sa_sigaction = EditBuffer_catchCutShort;
+        action.sa_flags     = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGBUS, &action, NULL);
+}
+
+/* EditBuffer_addMapping
+ * Lets the SIGBUS handler know that a file was mapped at data, for length
+ * bytes.
+ */
+static void EditBuffer_addMapping (void *data, size_t length) {
+        uintptr_t start = (uintptr_t)(data);
+        uintptr_t end   = (start + length + pageSize - 1) & ~(pageSize - 1);
+
+        pthread_mutex_lock(&mappingsLock);
+
+        // the end is filled in first, so the handler never sees a range that
+        // has a start but the end of whatever used to be there
+        EditBuffer_Mapping *mapping = mappings;
+        for (; mapping != NULL; mapping = mapping->next) {
+                if (mapping->start != 0) { continue; }
+                mapping->end   = end;
+                mapping->start = start;
+                pthread_mutex_unlock(&mappingsLock);
+                return;
+        }
+
+        mapping = malloc(sizeof(EditBuffer_Mapping));
+        mapping->start = start;
+        mapping->end   = end;
+        mapping->next  = mappings;
+        mappings = mapping;
+        pthread_mutex_unlock(&mappingsLock);
+}
+
+/* EditBuffer_removeMapping
+ * Lets the SIGBUS handler know that the file mapped at data is about to be
+ * unmapped.
+ */
+static void EditBuffer_removeMapping (void *data) {
+        pthread_mutex_lock(&mappingsLock);
+        EditBuffer_Mapping *mapping = mappings;
+        for (; mapping != NULL; mapping = mapping->next) {
+                if (mapping->start != (uintptr_t)(data)) { continue; }
+                mapping->start = 0;
+                mapping->end   = 0;
+                break;
+        }
+        pthread_mutex_unlock(&mappingsLock);
+}
+
+/* EditBuffer_catchCutShort
+ * The SIGBUS handler set up by EditBuffer_guardMappings. Only faults from
+ * reading past the end of a file mapped by EditBuffer_loadOriginal are caught.
+ * For anything else, the handler takes itself out, so that the fault happens
+ * again and is fatal like it normally would be.
+ */
+static void EditBuffer_catchCutShort (
+        int       number,
+        siginfo_t *info,
+        void      *context
+) {
+        (void)(context);
+
+        uintptr_t address = (uintptr_t)(info->si_addr);
+        EditBuffer_Mapping *mapping = mappings;
+        for (; mapping != NULL; mapping = mapping->next) {
+                uintptr_t start = mapping->start;
+                if (start == 0 || address < start) { continue; }
+                if (address >= mapping->end)       { continue; }
+                if (info->si_code != BUS_ADRERR)   { break; }
+
+                void *zeros = mmap (
+                        (void *)(address & ~(pageSize - 1)), pageSize,
+                        PROT_READ,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+                        -1, 0);
+                if (zeros != MAP_FAILED) { return; }
+                break;
+        }
+
+        signal(number, SIG_DFL);
+}
+
+/* EditBuffer_readOriginal
+ * Reads the rest of file into memory as the contents of original. This is used
+ * for files that cannot be mapped.
+ */
+static void EditBuffer_readOriginal (EditBuffer_Original *original, int file) {
+        size_t size = 4096;
+        original->data = malloc(size);
+        original->size = 0;
+
+        for (;;) {
+                ssize_t amountRead = read (
+                        file,
+                        original->data + original->size,
+                        size - original->size);
+                if (amountRead <= 0) { break; }
+                
+                original->size += (size_t)(amountRead);
+                if (original->size == size) {
+                        size *= 2;
+                        original->data = realloc(original->data, size);
+                }
+        }
+}
+
+/* EditBuffer_updateLength
+ * Updates the length of the edit buffer to match the piece tree, and makes sure
+ * the scroll is still within bounds.
+ */
+static void EditBuffer_updateLength (EditBuffer *editBuffer) {
+        editBuffer->length = 0;
+        if (editBuffer->pieces != NULL) {
+                editBuffer->length = editBuffer->pieces->subtreeLength;
+        }
+
+        if (editBuffer->scroll >= editBuffer->length) {
+                editBuffer->scroll = editBuffer->length;
+        }
+}
+
+/* EditBuffer_Piece_new
+ * Allocates a new piece spanning length lines of the original file buffer,
+ * starting at start. If line is not NULL, the piece holds that line instead.
+ */
+static EditBuffer_Piece *EditBuffer_Piece_new (
+        size_t start,
+        size_t length,
+        String *line
+) {
+        // xorshift, good enough to keep the tree balanced
+        static uint32_t seed = 0x9E3779B9;
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        EditBuffer_Piece *piece = calloc(1, sizeof(EditBuffer_Piece));
+        piece->priority = seed;
+        piece->start    = start;
+        piece->length   = length;
+        piece->line     = line;
+        EditBuffer_Piece_update(piece);
+        return piece;
+}
+
+/* EditBuffer_Piece_free
+ * Frees a piece, all of its children, and any lines they hold.
+ */
+static void EditBuffer_Piece_free (EditBuffer_Piece *piece) {
+        if (piece == NULL) { return; }
+
+        EditBuffer_Piece_free(piece->left);
+        EditBuffer_Piece_free(piece->right);
+        if (piece->line != NULL) { String_free(piece->line); }
+        free(piece);
+}
+
+/* EditBuffer_Piece_update
+ * Recalculates the amount of lines spanned by a piece and its children. This
+ * must be called whenever the children of a piece change.
+ */
+static void EditBuffer_Piece_update (EditBuffer_Piece *piece) {
+        piece->subtreeLength = piece->length;
+        if (piece->left  != NULL) {
+                piece->subtreeLength += piece->left->subtreeLength;
+        }
+        if (piece->right != NULL) {
+                piece->subtreeLength += piece->right->subtreeLength;
+        }
+}
+
+/* EditBuffer_Piece_merge
+ * Joins two trees together, with all lines in left coming before all lines in
+ * right. Returns the root of the resulting tree.
+ */
+static EditBuffer_Piece *EditBuffer_Piece_merge (
+        EditBuffer_Piece *left,
+        EditBuffer_Piece *right
+) {
+        if (left  == NULL) { return right; }
+        if (right == NULL) { return left;  }
+
+        if (left->priority > right->priority) {
+                left->right = EditBuffer_Piece_merge(left->right, right);
+                EditBuffer_Piece_update(left);
+                return left;
+        } else {
+                right->left = EditBuffer_Piece_merge(left, right->left);
+                EditBuffer_Piece_update(right);
+                return right;
+        }
+}
+
+/* EditBuffer_Piece_split
+ * Splits a tree into two, such that the first amount lines end up in left, and
+ * the rest end up in right. If the split point lands in the middle of a piece,
+ * that piece is broken in two.
+ */
+static void EditBuffer_Piece_split (
+        EditBuffer_Piece *piece,
+        size_t amount,
+        EditBuffer_Piece **left,
+        EditBuffer_Piece **right
+) {
+        if (piece == NULL) {
+                *left  = NULL;
+                *right = NULL;
+                return;
+        }
+
+        size_t leftLength = 0;
+        if (piece->left != NULL) { leftLength = piece->left->subtreeLength; }
+
+        if (amount <= leftLength) {
+                EditBuffer_Piece_split(piece->left, amount, left, &piece->left);
+                EditBuffer_Piece_update(piece);
+                *right = piece;
+                return;
+        }
+
+        if (amount >= leftLength + piece->length) {
+                EditBuffer_Piece_split (
+                        piece->right,
+                        amount - leftLength - piece->length,
+                        &piece->right, right);
+                EditBuffer_Piece_update(piece);
+                *left = piece;
+                return;
+        }
+
+        // the split point is inside of this piece. only runs of original lines
+        // can be split, as added pieces are always a single line long. the
+        // second half inherits the priority of the first so that the heap
+        // order of the tree is kept intact.
+        size_t offset = amount - leftLength;
+        EditBuffer_Piece *second = EditBuffer_Piece_new (
+                piece->start  + offset,
+                piece->length - offset,
+                NULL);
+        second->priority = piece->priority;
+        second->right    = piece->right;
+        piece->right     = NULL;
+        piece->length    = offset;
+
+        EditBuffer_Piece_update(second);
+        EditBuffer_Piece_update(piece);
+        *left  = piece;
+        *right = second;
+}
+
+/* EditBuffer_Piece_find
+ * Returns the piece containing row, and stores how far into that piece the row
+ * is in offset.
+ */
+static EditBuffer_Piece *EditBuffer_Piece_find (
+        EditBuffer_Piece *piece,
+        size_t row,
+        size_t *offset
+) {
+        while (piece != NULL) {
+                size_t leftLength = 0;
+                if (piece->left != NULL) {
+                        leftLength = piece->left->subtreeLength;
+                }
+
+                if (row < leftLength) {
+                        piece = piece->left;
+                } else if (row < leftLength + piece->length) {
+                        *offset = row - leftLength;
+                        return piece;
+                } else {
+                        row  -= leftLength + piece->length;
+                        piece = piece->right;
+                }
+        }
+
+        return NULL;
+}
+
+/* EditBuffer_Piece_build
+ * Builds a tree out of a piece for each line, in linear time. Pieces are added
+ * one at a time along the right edge of the tree, which is kept on a stack.
+ * Each new piece takes the pieces on the edge with lower priorities than its
+ * own as its left child, so the tree ends up the same as if every piece had
+ * been merged in separately.
+ */
+static EditBuffer_Piece *EditBuffer_Piece_build (
+        String **lines,
+        size_t amount
+) {
+        EditBuffer_Piece **edge = malloc(amount * sizeof(EditBuffer_Piece *));
+        size_t edgeLength = 0;
+
+        for (size_t index = 0; index < amount; index ++) {
+                EditBuffer_Piece *piece =
+                        EditBuffer_Piece_new(0, 1, lines[index]);
+
+                EditBuffer_Piece *last = NULL;
+                while (
+                        edgeLength > 0 &&
+                        edge[edgeLength - 1]->priority <= piece->priority
+                ) {
+                        last = edge[-- edgeLength];
+                        EditBuffer_Piece_update(last);
+                }
+
+                piece->left = last;
+                if (edgeLength > 0) { edge[edgeLength - 1]->right = piece; }
+                edge[edgeLength ++] = piece;
+        }
+
+        while (edgeLength > 1) { EditBuffer_Piece_update(edge[-- edgeLength]); }
+        EditBuffer_Piece *root = edge[0];
+        EditBuffer_Piece_update(root);
+
+        free(edge);
+        return root;
+}
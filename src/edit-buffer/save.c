@@ -0,0 +1,432 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "module.h"
+
+// the most parts that can be written in one go. POSIX only guarantees 16, but
+// every system this runs on allows at least this many.
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+static Error EditBuffer_canSave       (EditBuffer *);
+static void  EditBuffer_freeze        (EditBuffer *);
+static void  EditBuffer_measurePieces (EditBuffer_Piece *, size_t *, size_t *);
+static void  EditBuffer_freezePieces  (
+        EditBuffer *,
+        EditBuffer_Piece *,
+        size_t *);
+
+static void   EditBuffer_Save_addPart       (EditBuffer_Save *, char *, size_t);
+static size_t EditBuffer_Save_copyLine      (String *, char *);
+static void  *EditBuffer_Save_run           (void *);
+static Error  EditBuffer_Save_write         (EditBuffer_Save *);
+static int    EditBuffer_Save_writeParts    (int, struct iovec *, size_t);
+static void   EditBuffer_Save_readBack      (EditBuffer_Save *, int);
+static void   EditBuffer_Save_syncDirectory (const char *);
+static void   EditBuffer_Save_free          (EditBuffer_Save *);
+
+/* EditBuffer_save
+ * Starts saving the buffer to its file path, and returns right away. The text
+ * is written to a temporary file next to it first, which is then moved into
+ * place once it is safely on disk, so the file is never left half written. If a
+ * save is already in progress, this waits for it to finish first. The result of
+ * the save can be gotten with EditBuffer_finishSave, even if it failed before
+ * it could get going and this returned an error right away.
+ */
+Error EditBuffer_save (EditBuffer *editBuffer) {
+        EditBuffer_Save *save = &editBuffer->save;
+
+        // the last save has to be done, and the journal has to have caught up
+        // with it, before its result is replaced
+        EditBuffer_finishSave(editBuffer);
+        EditBuffer_flushJournal(editBuffer);
+        EditBuffer_Original_free(&save->saved);
+
+        save->result = EditBuffer_canSave(editBuffer);
+        if (save->result != Error_none) { return save->result; }
+
+        EditBuffer_freeze(editBuffer);
+        EditBuffer_journalSave(editBuffer);
+
+        // if the file path is a symbolic link, the file it points to is the one
+        // that is saved, instead of the link being replaced with a new file.
+        // if the file doesn't exist yet, there is nothing to resolve.
+        if (realpath(editBuffer->filePath, save->filePath) == NULL) {
+                Utility_copyCString (
+                        save->filePath,
+                        editBuffer->filePath,
+                        PATH_MAX);
+        }
+
+        // keep the permissions of the file if it already exists, otherwise
+        // give it the ones any new file would have
+        struct stat info;
+        if (stat(save->filePath, &info) == 0) {
+                save->mode = info.st_mode & 07777;
+        } else {
+                mode_t mask = umask(0);
+                umask(mask);
+                save->mode = 0666 & ~mask;
+        }
+
+        save->result = Error_none;
+        atomic_store(&save->finished, 0);
+        if (pthread_create(&save->thread, NULL, EditBuffer_Save_run, save)) {
+                // if there is no thread to do it on, just do it here
+                save->result = EditBuffer_Save_write(save);
+                EditBuffer_Save_free(save);
+                return save->result;
+        }
+
+        save->running = 1;
+        return Error_none;
+}
+
+/* EditBuffer_finishSave
+ * Waits for the save in progress to finish, if there is one, and returns its
+ * result. If there is no save in progress, this returns the result of the last
+ * one.
+ */
+Error EditBuffer_finishSave (EditBuffer *editBuffer) {
+        EditBuffer_Save *save = &editBuffer->save;
+        if (!save->running) { return save->result; }
+
+        pthread_join(save->thread, NULL);
+        save->running = 0;
+        EditBuffer_Save_free(save);
+        return save->result;
+}
+
+/* EditBuffer_isSaving
+ * Returns 1 if the buffer is still being written out, and 0 if it isn't. Once
+ * this returns 0, EditBuffer_finishSave will not block.
+ */
+int EditBuffer_isSaving (EditBuffer *editBuffer) {
+        EditBuffer_Save *save = &editBuffer->save;
+        return save->running && !atomic_load(&save->finished);
+}
+
+/* EditBuffer_canSave
+ * Returns Error_none if the buffer can be saved, and Error_cantSaveFile if it
+ * can't.
+ */
+static Error EditBuffer_canSave (EditBuffer *editBuffer) {
+        if (editBuffer->filePath[0] == '\0') { return Error_cantSaveFile; }
+        if (editBuffer->readOnly)             { return Error_cantSaveFile; }
+
+        // the rest of the file and any unsaved work from its journal haven't
+        // been put in yet
+        if (!EditBuffer_isLoaded(editBuffer)) { return Error_cantSaveFile; }
+
+        // if the file was cut short on disk after it was mapped, the part of
+        // it that is gone reads as zeros, which must not be saved in place of
+        // the text that was there. if the file at the file path has been
+        // replaced since it was mapped, nothing else can get to it.
+        EditBuffer_Original *original = &editBuffer->original;
+        struct stat info;
+        if (
+                original->mapped &&
+                stat(editBuffer->filePath, &info) == 0 &&
+                info.st_dev == original->device &&
+                info.st_ino == original->inode &&
+                (size_t)(info.st_size) < original->size
+        ) {
+                return Error_cantSaveFile;
+        }
+
+        return Error_none;
+}
+
+/* EditBuffer_freeze
+ * Freezes the contents of the buffer into the parts of its save. Edited lines
+ * are all copied into one block of text, and everything else is left where it
+ * is in the original file buffer.
+ */
+static void EditBuffer_freeze (EditBuffer *editBuffer) {
+        EditBuffer_Save *save = &editBuffer->save;
+
+        size_t amountOfPieces = 0;
+        size_t textSize       = 0;
+        EditBuffer_measurePieces (
+                editBuffer->pieces,
+                &amountOfPieces, &textSize);
+
+        // each piece needs at most one part, and one more for a line break
+        save->parts = malloc((amountOfPieces * 2 + 1) * sizeof(struct iovec));
+        save->text  = malloc(textSize + 1);
+        save->amountOfParts = 0;
+        save->textLength    = 0;
+
+        size_t row = 0;
+        EditBuffer_freezePieces(editBuffer, editBuffer->pieces, &row);
+}
+
+/* EditBuffer_measurePieces
+ * Counts up the amount of pieces in a tree, and how many bytes the edited lines
+ * in it can take up at most once they are copied.
+ */
+static void EditBuffer_measurePieces (
+        EditBuffer_Piece *piece,
+        size_t *amountOfPieces,
+        size_t *textSize
+) {
+        if (piece == NULL) { return; }
+
+        EditBuffer_measurePieces(piece->left, amountOfPieces, textSize);
+        (*amountOfPieces) ++;
+        if (piece->line != NULL) { *textSize += piece->line->byteLength + 1; }
+        EditBuffer_measurePieces(piece->right, amountOfPieces, textSize);
+}
+
+/* EditBuffer_freezePieces
+ * Adds the parts of every piece in a tree to the save, in order. Every line
+ * ends with a line break, except for the last line of the buffer. row is the
+ * row the tree starts on, and is moved past the end of it.
+ */
+static void EditBuffer_freezePieces (
+        EditBuffer       *editBuffer,
+        EditBuffer_Piece *piece,
+        size_t           *row
+) {
+        if (piece == NULL) { return; }
+
+        EditBuffer_Save     *save     = &editBuffer->save;
+        EditBuffer_Original *original = &editBuffer->original;
+
+        EditBuffer_freezePieces(editBuffer, piece->left, row);
+
+        *row += piece->length;
+        int last = *row == editBuffer->length;
+
+        if (piece->line != NULL) {
+                char  *start  = save->text + save->textLength;
+                size_t length = EditBuffer_Save_copyLine(piece->line, start);
+                if (!last) { start[length ++] = '\n'; }
+
+                save->textLength += length;
+                EditBuffer_Save_addPart(save, start, length);
+        } else {
+                // lines in the original file buffer already end in a line
+                // break, unless the file itself ends without one
+                size_t end         = piece->start + piece->length;
+                size_t startOffset = original->lines.starts[piece->start];
+                size_t endOffset   = original->size;
+                int    hasBreak    = end < original->lines.amountOfLines;
+                if (hasBreak) { endOffset = original->lines.starts[end]; }
+                if (hasBreak && last) { endOffset --; }
+
+                EditBuffer_Save_addPart (
+                        save,
+                        original->data + startOffset,
+                        endOffset - startOffset);
+                if (!hasBreak && !last) {
+                        EditBuffer_Save_addPart(save, "\n", 1);
+                }
+        }
+
+        EditBuffer_freezePieces(editBuffer, piece->right, row);
+}
+
+/* EditBuffer_Save_addPart
+ * Adds length bytes at buffer to the parts of a save. If they come right after
+ * the last part, that part is extended instead.
+ */
+static void EditBuffer_Save_addPart (
+        EditBuffer_Save *save,
+        char            *buffer,
+        size_t          length
+) {
+        if (length == 0) { return; }
+
+        if (save->amountOfParts > 0) {
+                struct iovec *previous = &save->parts[save->amountOfParts - 1];
+                char *end = (char *)(previous->iov_base) + previous->iov_len;
+                if (end == buffer) {
+                        previous->iov_len += length;
+                        return;
+                }
+        }
+
+        save->parts[save->amountOfParts ++] = (struct iovec) {
+                .iov_base = buffer,
+                .iov_len  = length,
+        };
+}
+
+/* EditBuffer_Save_copyLine
+ * Copies the text of a line to destination, and returns the amount of bytes
+ * copied. Bad byte runes are turned back into the bytes they stand for, so
+ * whatever couldn't be decoded when the file was loaded is saved exactly as it
+ * was.
+ */
+static size_t EditBuffer_Save_copyLine (String *line, char *destination) {
+        const char *buffer = line->buffer;
+        size_t      length = line->byteLength;
+
+        // bad byte runes are all encoded starting with 0xED, which pure ASCII
+        // text can't have
+        if (line->length == length) {
+                memcpy(destination, buffer, length);
+                return length;
+        }
+
+        size_t copied = 0;
+        size_t index  = 0;
+        while (index < length) {
+                const char *next = memchr(buffer + index, 0xED, length - index);
+                size_t end = length;
+                if (next != NULL) { end = (size_t)(next - buffer); }
+
+                memcpy(destination + copied, buffer + index, end - index);
+                copied += end - index;
+                index   = end;
+                if (next == NULL) { break; }
+
+                Rune rune = Unicode_utf8ArrayToRune (
+                        (const uint8_t *)(next), 3);
+                if (Unicode_isBadByte(rune)) {
+                        destination[copied ++] =
+                                (char)(Unicode_runeToBadByte(rune));
+                } else {
+                        memcpy(destination + copied, next, 3);
+                        copied += 3;
+                }
+                index += 3;
+        }
+
+        return copied;
+}
+
+/* EditBuffer_Save_run
+ * The worker thread that writes out a save.
+ */
+static void *EditBuffer_Save_run (void *argument) {
+        EditBuffer_Save *save = argument;
+        save->result = EditBuffer_Save_write(save);
+        atomic_store(&save->finished, 1);
+        EditBuffer_notifyWorkerFinish();
+        return NULL;
+}
+
+/* EditBuffer_Save_write
+ * Writes the parts of a save to a temporary file, flushes it to disk, and then
+ * renames it over the real file. If anything goes wrong, the temporary file is
+ * removed and the real file is left alone. The file is read back into the save
+ * before it is closed. See EditBuffer_Save_readBack.
+ */
+static Error EditBuffer_Save_write (EditBuffer_Save *save) {
+        char tempPath[PATH_MAX + 8];
+        snprintf(tempPath, sizeof(tempPath), "%s.XXXXXX", save->filePath);
+
+        int file = mkstemp(tempPath);
+        if (file < 0) { return Error_cantSaveFile; }
+
+        int ok = fchmod(file, save->mode) == 0;
+        ok = ok && EditBuffer_Save_writeParts (
+                file,
+                save->parts,
+                save->amountOfParts);
+        ok = ok && fsync(file) == 0;
+        if (ok) { EditBuffer_Save_readBack(save, file); }
+        ok = (close(file) == 0) && ok;
+        ok = ok && rename(tempPath, save->filePath) == 0;
+
+        if (!ok) {
+                EditBuffer_Original_free(&save->saved);
+                unlink(tempPath);
+                return Error_cantSaveFile;
+        }
+
+        EditBuffer_Save_syncDirectory(save->filePath);
+        return Error_none;
+}
+
+/* EditBuffer_Save_writeParts
+ * Writes out amount parts to file, as many at a time as the system allows.
+ * Returns 1 if everything was written, and 0 if something went wrong. The parts
+ * are used up in the process.
+ */
+static int EditBuffer_Save_writeParts (
+        int          file,
+        struct iovec *parts,
+        size_t       amount
+) {
+        size_t index = 0;
+        while (index < amount) {
+                ssize_t written = writev (
+                        file,
+                        parts + index,
+                        (int)(MIN(amount - index, IOV_MAX)));
+                if (written < 0 && errno == EINTR) { continue; }
+                if (written <= 0)                  { return 0; }
+
+                // skip over the parts that got written, and trim the one that
+                // was only written partway through
+                size_t left = (size_t)(written);
+                while (index < amount && left >= parts[index].iov_len) {
+                        left -= parts[index].iov_len;
+                        index ++;
+                }
+                if (left > 0) {
+                        parts[index].iov_base =
+                                (char *)(parts[index].iov_base) + left;
+                        parts[index].iov_len -= left;
+                }
+        }
+
+        return 1;
+}
+
+/* EditBuffer_Save_readBack
+ * Opens the file that was just written as an original file buffer, and indexes
+ * all of its lines, so that the buffer can be based on it once the save is
+ * done. This is done here so that it doesn't hold up the main thread. If it
+ * can't be done, saved is left empty.
+ */
+static void EditBuffer_Save_readBack (EditBuffer_Save *save, int file) {
+        if (lseek(file, 0, SEEK_SET) != 0) { return; }
+
+        EditBuffer_Original *saved = &save->saved;
+        EditBuffer_Original_open(saved, file);
+        saved->lines = EditBuffer_LineIndex_new(1);
+        EditBuffer_indexLines(saved->data, 0, saved->size, &saved->lines);
+}
+
+/* EditBuffer_Save_syncDirectory
+ * Flushes the directory a file is in to disk, so that a file that was just
+ * renamed into it stays there.
+ */
+static void EditBuffer_Save_syncDirectory (const char *filePath) {
+        char directoryPath[PATH_MAX + 1];
+        Utility_copyCString(directoryPath, filePath, PATH_MAX);
+
+        char *slash = strrchr(directoryPath, '/');
+        if (slash == NULL) {
+                Utility_copyCString(directoryPath, ".", PATH_MAX);
+        } else if (slash == directoryPath) {
+                slash[1] = '\0';
+        } else {
+                slash[0] = '\0';
+        }
+
+        int directory = open(directoryPath, O_RDONLY | O_DIRECTORY);
+        if (directory < 0) { return; }
+        fsync(directory);
+        close(directory);
+}
+
+/* EditBuffer_Save_free
+ * Frees the frozen contents of a save.
+ */
+static void EditBuffer_Save_free (EditBuffer_Save *save) {
+        free(save->parts);
+        free(save->text);
+        save->parts         = NULL;
+        save->text          = NULL;
+        save->amountOfParts = 0;
+        save->textLength    = 0;
+}
@@ -0,0 +1,361 @@
+#include <stdint.h>
+
+#include "module.h"
+#include "options.h"
+#include "utility.h"
+
+#define NO_SLOT SIZE_MAX
+
+static size_t Interface_GlyphAtlas_find   (
+        Interface_GlyphAtlas *,
+        unsigned int);
+static size_t Interface_GlyphAtlas_take   (Interface_GlyphAtlas *);
+static void   Interface_GlyphAtlas_render (
+        Interface_GlyphAtlas *,
+        size_t,
+        unsigned int);
+static void   Interface_GlyphAtlas_unlink (Interface_GlyphAtlas *, size_t);
+static void   Interface_GlyphAtlas_link   (Interface_GlyphAtlas *, size_t);
+static void   Interface_GlyphAtlas_blendRow (
+        uint32_t *,
+        const uint8_t *,
+        int,
+        uint32_t);
+static uint8_t Interface_GlyphAtlas_coverage (FT_Bitmap *, int, int);
+static int    Interface_GlyphAtlas_floor (FT_Pos);
+static int    Interface_GlyphAtlas_ceil  (FT_Pos);
+
+/* Interface_GlyphAtlas_start
+ * Opens the font at path for the atlas to rasterize glyphs with, and sets its
+ * slots up to fit the bounding box of the face, so that glyphs aren't cut off
+ * unless hinting moves them well outside of it. The atlas takes up at most
+ * Options_glyphAtlasSize bytes. The face is opened again, separately from the
+ * one cairo uses, so that setting its size can't throw cairo off.
+ */
+Error Interface_GlyphAtlas_start (
+        Interface_GlyphAtlas *atlas,
+        const char           *path
+) {
+        int err = FT_New_Face (
+                interface.fonts.freetypeHandle,
+                path, 0, &atlas->face);
+        if (err) {
+                atlas->face = NULL;
+                return Error_cantLoadFont;
+        }
+        FT_Set_Pixel_Sizes(atlas->face, 0, (FT_UInt)(Options_fontSize));
+
+        // bitmap fonts don't have a bounding box, but their glyphs all fit
+        // within the metrics of their size
+        FT_Size_Metrics *metrics = &atlas->face->size->metrics;
+        FT_Pos top    = metrics->ascender;
+        FT_Pos bottom = metrics->descender;
+        FT_Pos left   = 0;
+        FT_Pos right  = metrics->max_advance;
+        if (FT_IS_SCALABLE(atlas->face)) {
+                FT_BBox *box = &atlas->face->bbox;
+                top    = FT_MulFix(box->yMax, metrics->y_scale);
+                bottom = FT_MulFix(box->yMin, metrics->y_scale);
+                left   = FT_MulFix(box->xMin, metrics->x_scale);
+                right  = FT_MulFix(box->xMax, metrics->x_scale);
+        }
+
+        // hinting can nudge a glyph a pixel past its bounding box, so there is
+        // a pixel to spare on every side
+        int leftmost   = MIN(Interface_GlyphAtlas_floor(left),   0);
+        int rightmost  = MAX(Interface_GlyphAtlas_ceil(right),   0);
+        int topmost    = MAX(Interface_GlyphAtlas_ceil(top),     0);
+        int bottommost = MIN(Interface_GlyphAtlas_floor(bottom), 0);
+        atlas->originX    = 1 - leftmost;
+        atlas->baseline   = 1 + topmost;
+        atlas->slotWidth  = atlas->originX  + rightmost  + 1;
+        atlas->slotHeight = atlas->baseline - bottommost + 1;
+
+        size_t slotSize = (size_t)(atlas->slotWidth * atlas->slotHeight);
+        atlas->amountOfSlots = MAX(Options_glyphAtlasSize / slotSize, 16);
+        atlas->pixels = calloc(atlas->amountOfSlots, slotSize);
+        atlas->slots  = calloc (
+                atlas->amountOfSlots,
+                sizeof(Interface_GlyphSlot));
+        atlas->slotsUsed = 0;
+        atlas->newest    = NO_SLOT;
+        atlas->oldest    = NO_SLOT;
+
+        atlas->amountOfGlyphs = (size_t)(atlas->face->num_glyphs);
+        atlas->slotOfGlyph = malloc(atlas->amountOfGlyphs * sizeof(size_t));
+        for (size_t index = 0; index < atlas->amountOfGlyphs; index ++) {
+                atlas->slotOfGlyph[index] = NO_SLOT;
+        }
+
+        return Error_none;
+}
+
+/* Interface_GlyphAtlas_free
+ * Frees everything the atlas holds on to, including its face. It can be
+ * started again afterwards.
+ */
+void Interface_GlyphAtlas_free (Interface_GlyphAtlas *atlas) {
+        if (atlas->face != NULL) { FT_Done_Face(atlas->face); }
+        free(atlas->pixels);
+        free(atlas->slots);
+        free(atlas->slotOfGlyph);
+        *atlas = (const Interface_GlyphAtlas) { 0 };
+}
+
+/* Interface_GlyphAtlas_canDraw
+ * Returns 1 if the atlas can draw onto whatever context is drawing into. This
+ * is only the case once it has been started, and if the context draws into an
+ * image in memory whose pixels can be written to directly.
+ */
+int Interface_GlyphAtlas_canDraw (
+        Interface_GlyphAtlas *atlas,
+        cairo_t              *context
+) {
+        if (atlas->face == NULL) { return 0; }
+
+        cairo_surface_t *target = cairo_get_target(context);
+        if (cairo_surface_get_type(target) != CAIRO_SURFACE_TYPE_IMAGE) {
+                return 0;
+        }
+
+        cairo_format_t format = cairo_image_surface_get_format(target);
+        return
+                format == CAIRO_FORMAT_RGB24 ||
+                format == CAIRO_FORMAT_ARGB32;
+}
+
+/* Interface_GlyphAtlas_draw
+ * Blends glyph onto surface in color, with its origin at x and y. The glyph is
+ * rasterized into the atlas first if it isn't there already. surface must be an
+ * image surface that was flushed, and it has to be marked dirty afterwards.
+ */
+void Interface_GlyphAtlas_draw (
+        Interface_GlyphAtlas *atlas,
+        cairo_surface_t      *surface,
+        unsigned int         glyph,
+        double               x,
+        double               y,
+        uint32_t             color
+) {
+        if (glyph >= atlas->amountOfGlyphs) { return; }
+
+        size_t slot = Interface_GlyphAtlas_find(atlas, glyph);
+        if (slot == NO_SLOT) {
+                slot = Interface_GlyphAtlas_take(atlas);
+                Interface_GlyphAtlas_render(atlas, slot, glyph);
+        }
+
+        uint8_t *data   = cairo_image_surface_get_data(surface);
+        int      stride = cairo_image_surface_get_stride(surface);
+        int      width  = cairo_image_surface_get_width(surface);
+        int      height = cairo_image_surface_get_height(surface);
+
+        // whatever hangs off the edge of the surface is cut off
+        int left = (int)(x + 0.5) - atlas->originX;
+        int top  = (int)(y + 0.5) - atlas->baseline;
+        int startX = MAX(0, -left);
+        int startY = MAX(0, -top);
+        int endX   = MIN(atlas->slotWidth,  width  - left);
+        int endY   = MIN(atlas->slotHeight, height - top);
+        if (startX >= endX || startY >= endY) { return; }
+
+        const uint8_t *coverage =
+                atlas->pixels +
+                slot * (size_t)(atlas->slotWidth * atlas->slotHeight);
+        for (int row = startY; row < endY; row ++) {
+                uint32_t *destination = (uint32_t *)(void *)(
+                        data +
+                        (size_t)(top + row) * (size_t)(stride) +
+                        (size_t)(left + startX) * sizeof(uint32_t));
+                Interface_GlyphAtlas_blendRow (
+                        destination,
+                        coverage + row * atlas->slotWidth + startX,
+                        endX - startX,
+                        color);
+        }
+}
+
+/* Interface_GlyphAtlas_find
+ * Returns the slot glyph is in, and marks it as the most recently used one. If
+ * it isn't in the atlas, this returns NO_SLOT.
+ */
+static size_t Interface_GlyphAtlas_find (
+        Interface_GlyphAtlas *atlas,
+        unsigned int         glyph
+) {
+        size_t slot = atlas->slotOfGlyph[glyph];
+        if (slot == NO_SLOT) { return NO_SLOT; }
+
+        if (slot != atlas->newest) {
+                Interface_GlyphAtlas_unlink(atlas, slot);
+                Interface_GlyphAtlas_link(atlas, slot);
+        }
+        return slot;
+}
+
+/* Interface_GlyphAtlas_take
+ * Returns a slot that a new glyph can be put in, marked as the most recently
+ * used one. Once every slot has been used, the one that was used the longest
+ * time ago is taken away from its glyph.
+ */
+static size_t Interface_GlyphAtlas_take (Interface_GlyphAtlas *atlas) {
+        size_t slot;
+        if (atlas->slotsUsed < atlas->amountOfSlots) {
+                slot = atlas->slotsUsed ++;
+        } else {
+                slot = atlas->oldest;
+                atlas->slotOfGlyph[atlas->slots[slot].glyph] = NO_SLOT;
+                Interface_GlyphAtlas_unlink(atlas, slot);
+        }
+
+        Interface_GlyphAtlas_link(atlas, slot);
+        return slot;
+}
+
+/* Interface_GlyphAtlas_render
+ * Rasterizes glyph into slot. Whatever doesn't fit in the slot is cut off, and
+ * if FreeType can't render the glyph, the slot is left empty.
+ */
+static void Interface_GlyphAtlas_render (
+        Interface_GlyphAtlas *atlas,
+        size_t               slot,
+        unsigned int         glyph
+) {
+        size_t   slotSize = (size_t)(atlas->slotWidth * atlas->slotHeight);
+        uint8_t *pixels   = atlas->pixels + slot * slotSize;
+        memset(pixels, 0, slotSize);
+
+        atlas->slots[slot].glyph  = glyph;
+        atlas->slotOfGlyph[glyph] = slot;
+
+        if (FT_Load_Glyph(atlas->face, glyph, FT_LOAD_RENDER)) { return; }
+        FT_GlyphSlot rendered = atlas->face->glyph;
+        FT_Bitmap   *bitmap   = &rendered->bitmap;
+        if (
+                bitmap->pixel_mode != FT_PIXEL_MODE_GRAY &&
+                bitmap->pixel_mode != FT_PIXEL_MODE_MONO
+        ) {
+                return;
+        }
+
+        int left = atlas->originX  + rendered->bitmap_left;
+        int top  = atlas->baseline - rendered->bitmap_top;
+        for (int row = 0; row < (int)(bitmap->rows); row ++) {
+                int y = top + row;
+                if (y < 0 || y >= atlas->slotHeight) { continue; }
+
+                for (int column = 0; column < (int)(bitmap->width); column ++) {
+                        int x = left + column;
+                        if (x < 0 || x >= atlas->slotWidth) { continue; }
+
+                        pixels[y * atlas->slotWidth + x] =
+                                Interface_GlyphAtlas_coverage (
+                                        bitmap,
+                                        row, column);
+                }
+        }
+}
+
+/* Interface_GlyphAtlas_unlink
+ * Takes a slot out of the list of used slots.
+ */
+static void Interface_GlyphAtlas_unlink (
+        Interface_GlyphAtlas *atlas,
+        size_t               slot
+) {
+        Interface_GlyphSlot *entry = &atlas->slots[slot];
+
+        if (entry->newer == NO_SLOT) {
+                atlas->newest = entry->older;
+        } else {
+                atlas->slots[entry->newer].older = entry->older;
+        }
+
+        if (entry->older == NO_SLOT) {
+                atlas->oldest = entry->newer;
+        } else {
+                atlas->slots[entry->older].newer = entry->newer;
+        }
+}
+
+/* Interface_GlyphAtlas_link
+ * Puts a slot at the front of the list of used slots, as the newest one.
+ */
+static void Interface_GlyphAtlas_link (
+        Interface_GlyphAtlas *atlas,
+        size_t               slot
+) {
+        Interface_GlyphSlot *entry = &atlas->slots[slot];
+        entry->newer = NO_SLOT;
+        entry->older = atlas->newest;
+
+        if (atlas->newest != NO_SLOT) {
+                atlas->slots[atlas->newest].newer = slot;
+        }
+        atlas->newest = slot;
+        if (atlas->oldest == NO_SLOT) { atlas->oldest = slot; }
+}
+
+/* Interface_GlyphAtlas_blendRow
+ * Blends color into width pixels of destination, as much as coverage says for
+ * each one. There are no branches in the loop, so that the compiler can turn it
+ * into vector instructions.
+ */
+static void Interface_GlyphAtlas_blendRow (
+        uint32_t      *destination,
+        const uint8_t *coverage,
+        int           width,
+        uint32_t      color
+) {
+        uint32_t red   = (color >> 16) & 0xFF;
+        uint32_t green = (color >> 8)  & 0xFF;
+        uint32_t blue  =  color        & 0xFF;
+
+        for (int x = 0; x < width; x ++) {
+                uint32_t alpha   = coverage[x];
+                uint32_t inverse = 255 - alpha;
+                uint32_t pixel   = destination[x];
+
+                // dividing by 255, rounded, without actually dividing
+                uint32_t r = ((pixel >> 16) & 0xFF) * inverse + red   * alpha;
+                uint32_t g = ((pixel >> 8)  & 0xFF) * inverse + green * alpha;
+                uint32_t b = ( pixel        & 0xFF) * inverse + blue  * alpha;
+                r = (r + 128 + ((r + 128) >> 8)) >> 8;
+                g = (g + 128 + ((g + 128) >> 8)) >> 8;
+                b = (b + 128 + ((b + 128) >> 8)) >> 8;
+
+                destination[x] = 0xFF000000 | (r << 16) | (g << 8) | b;
+        }
+}
+
+/* Interface_GlyphAtlas_coverage
+ * Returns how much of the pixel at row and column a rendered glyph covers, from
+ * 0 to 255. Bitmap fonts usually render one bit per pixel, so those bits are
+ * spread out to fully covered or not covered at all.
+ */
+static uint8_t Interface_GlyphAtlas_coverage (
+        FT_Bitmap *bitmap,
+        int       row,
+        int       column
+) {
+        const uint8_t *line = bitmap->buffer + row * bitmap->pitch;
+        if (bitmap->pixel_mode == FT_PIXEL_MODE_GRAY) { return line[column]; }
+
+        int bit = (line[column / 8] >> (7 - column % 8)) & 1;
+        return (uint8_t)(bit * 255);
+}
+
+/* Interface_GlyphAtlas_floor
+ * Rounds a 26.6 fixed point FreeType position down to a whole pixel.
+ */
+static int Interface_GlyphAtlas_floor (FT_Pos position) {
+        if (position >= 0) { return (int)(position / 64); }
+        return -(int)((-position + 63) / 64);
+}
+
+/* Interface_GlyphAtlas_ceil
+ * Rounds a 26.6 fixed point FreeType position up to a whole pixel.
+ */
+static int Interface_GlyphAtlas_ceil (FT_Pos position) {
+        return -Interface_GlyphAtlas_floor(-position);
+}
@@ -29,6 +29,7 @@ void Interface_editView_recalculate (void) {
 void Interface_editView_redraw (void) {
         Interface_EditView     *editView = &interface.editView;
         Interface_EditViewText *text     = &editView->text;
+        Interface_Object_damage(editView);
         
         cairo_set_source_rgb(Window_context, BACKGROUND_COLOR);
         cairo_rectangle (
@@ -107,12 +108,14 @@ void Interface_updateTextSelection (void) {
                 cellX, cellY,
                 &realX, &realY);
 
+        // moving the cursor can reorder the cursors, so the primary one has
+        // to be looked up again before selecting
         EditBuffer_Cursor_moveTo (
-                text->buffer->cursors,
+                EditBuffer_getPrimaryCursor(text->buffer),
                 interface.mouseState.dragOriginRealX,
                 interface.mouseState.dragOriginRealY);
         EditBuffer_Cursor_selectTo (
-                text->buffer->cursors,
+                EditBuffer_getPrimaryCursor(text->buffer),
                 realX, realY);
 }
 
@@ -134,6 +137,20 @@ void Interface_editView_refresh (void) {
         Interface_editViewText_refresh();
 }
 
+/* Interface_editView_needsRefresh
+ * Returns 1 if refreshing the edit view would recalculate or redraw anything,
+ * or grab new text from its buffer.
+ */
+int Interface_editView_needsRefresh (void) {
+        Interface_EditView *editView = &interface.editView;
+
+        return
+                Interface_Object_isInvalid(editView)         ||
+                Interface_Object_isInvalid(&editView->ruler) ||
+                Interface_Object_isInvalid(&editView->text)  ||
+                editView->text.needsGrab;
+}
+
 /* Interface_editView_invalidateLayout
  * Invalidates the layout of the edit view.
  */
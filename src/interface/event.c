@@ -5,7 +5,7 @@
 #define OR ||
 #define BUFFER_EXISTS (interface.editView.text.buffer != NULL)
 
-static void conditionallyRefresh (int);
+static void requestRefresh       (void);
 static void updateHoverObject    (void);
 static int  checkTabSelect       (void);
 static int  checkNewTab          (void);
@@ -41,10 +41,32 @@ void Interface_onSwitchTab (void (*callback) (Interface_Tab *)) {
         interface.callbacks.onSwitchTab = callback;
 }
 
+/* Interface_onInterval
+ * Sets the function to be called every time the interval timer fires.
+ */
+void Interface_onInterval (void (*callback) (void)) {
+        interface.callbacks.onInterval = callback;
+}
+
+/* Interface_onFile
+ * Sets the function to be called when a file that was added with
+ * Interface_watchFile can be read from.
+ */
+void Interface_onFile (void (*callback) (int)) {
+        interface.callbacks.onFile = callback;
+}
+
+/* Interface_onWake
+ * Sets the function to be called after Interface_wake is called.
+ */
+void Interface_onWake (void (*callback) (void)) {
+        interface.callbacks.onWake = callback;
+}
+
 /* Interface_handleRedraw
  * Fires when the screen needs to be redrawn.
  */
-void Interface_handleRedraw (int render, int width, int height) {
+void Interface_handleRedraw (int width, int height) {
         // TODO: make generic setter method for this??
         interface.width  = width;
         interface.height = height;
@@ -52,14 +74,13 @@ void Interface_handleRedraw (int render, int width, int height) {
         Interface_invalidateLayout();
         Interface_invalidateDrawing();
 
-        conditionallyRefresh(render);
+        requestRefresh();
 }
 
 /* Interface_handleMouseButton
  * Fires when a mouse button is pressed or released.
  */
 void Interface_handleMouseButton (
-        int                render, 
         Window_MouseButton button,
         Window_State state
 ) {
@@ -169,19 +190,30 @@ void Interface_handleMouseButton (
                 break;
         }
         
-        conditionallyRefresh(render);
+        requestRefresh();
 }
 
 /* Interface_handleMouseMove
  * Fires when the mouse is moved.
  */
-void Interface_handleMouseMove (int render, int x, int y) {
-        interface.mouseState.x = x;
-        interface.mouseState.y = y;
+void Interface_handleMouseMove (int x, int y) {
+        Interface_MouseState *mouseState = &interface.mouseState;
+        if (x == mouseState->x && y == mouseState->y) { return; }
+
+        size_t previousCellX = mouseState->cellX;
+        size_t previousCellY = mouseState->cellY;
 
+        mouseState->x = x;
+        mouseState->y = y;
         updateHoverObject();
 
+        // the selection only changes when the mouse moves onto another cell
+        int cellChanged =
+                mouseState->cellX != previousCellX ||
+                mouseState->cellY != previousCellY;
+
         if (
+                cellChanged &&
                 interface.mouseState.left && 
                 interface.mouseState.dragOriginInEditView &&
                 BUFFER_EXISTS
@@ -191,13 +223,37 @@ void Interface_handleMouseMove (int render, int x, int y) {
                 Interface_editViewText_invalidateText();
         }
         
-        conditionallyRefresh(render);
+        requestRefresh();
 }
 
 /* updateHoverObject
  * Updates various information about what the mouse is currently hovering over.
  */
 static void updateHoverObject (void) {
+        Interface_findMouseHoverCell (
+                interface.mouseState.x,
+                interface.mouseState.y,
+                &interface.mouseState.cellX, &interface.mouseState.cellY);
+
+        // the ruler and the text have nothing inside of them, so as long as
+        // the mouse stays within the one it is over, nothing else needs to be
+        // checked. this is where the mouse spends most of its time, and where
+        // it moves the most while dragging.
+        Interface_Object *hoverObject = interface.mouseState.hoverObject;
+        if (
+                (
+                        hoverObject == TO_GENERIC(&interface.editView.text) ||
+                        hoverObject == TO_GENERIC(&interface.editView.ruler)
+                ) &&
+                Interface_Object_isWithinBounds (
+                        hoverObject,
+                        interface.mouseState.x,
+                        interface.mouseState.y)
+        ) {
+                interface.mouseState.previousHoverObject = hoverObject;
+                return;
+        }
+
         Interface_Object *newHoverObject = Interface_getHoveredObject (
                 interface.mouseState.x,
                 interface.mouseState.y);
@@ -212,11 +268,6 @@ static void updateHoverObject (void) {
                 interface.mouseState.x,
                 interface.mouseState.y);
 
-        Interface_findMouseHoverCell (
-                interface.mouseState.x,
-                interface.mouseState.y,
-                &interface.mouseState.cellX, &interface.mouseState.cellY);
-
         if (interface.mouseState.hoverObject != newHoverObject) {
                 if (
                         interface.mouseState.hoverObject != NULL &&
@@ -241,7 +292,7 @@ static void updateHoverObject (void) {
 /* Interface_handleInterval
  * Fires every 500 milliseconds.
  */
-void Interface_handleInterval (int render) {
+void Interface_handleInterval (void) {
         interface.editView.text.cursorBlink =
                 !interface.editView.text.cursorBlink;
 
@@ -249,15 +300,40 @@ void Interface_handleInterval (int render) {
         if (BUFFER_EXISTS) {
                 Interface_Object_invalidateDrawing(&interface.editView.text);
         }
+
+        if (interface.callbacks.onInterval != NULL) {
+                interface.callbacks.onInterval();
+        }
         
-        conditionallyRefresh(render);
+        requestRefresh();
+}
+
+/* Interface_handleFile
+ * Fires when a file that was added with Interface_watchFile can be read from.
+ */
+void Interface_handleFile (int fileDescriptor) {
+        if (interface.callbacks.onFile != NULL) {
+                interface.callbacks.onFile(fileDescriptor);
+        }
+
+        requestRefresh();
+}
+
+/* Interface_handleWake
+ * Fires after Interface_wake is called.
+ */
+void Interface_handleWake (void) {
+        if (interface.callbacks.onWake != NULL) {
+                interface.callbacks.onWake();
+        }
+
+        requestRefresh();
 }
 
 /* Interface_handleKey
  * Fires when a key is pressed or released.
  */
 void Interface_handleKey (
-        int           render,
         Window_KeySym keySym,
         Rune          rune,
         Window_State  state) {
@@ -391,6 +467,36 @@ void Interface_handleKey (
                                         interface.callbacks.onNewTab();
                                 }
                                 break;
+                        case 's':
+                                if (!BUFFER_EXISTS) { break; }
+                                // if the save gets going, whether it worked is
+                                // found out once it is done
+                                Interface_Tab_setSaveFailed (
+                                        interface.tabBar.activeTab,
+                                        EditBuffer_save (
+                                                interface.editView.text.buffer)
+                                        != Error_none);
+                                break;
+                        case 'z':
+                        case 'Z':
+                        case 'y':
+                                if (!BUFFER_EXISTS) { break; }
+                                if (
+                                        keySym == 'z' &&
+                                        !interface.modKeyState.shift
+                                ) {
+                                        EditBuffer_undo (
+                                                interface.editView.text.buffer);
+                                } else {
+                                        EditBuffer_redo (
+                                                interface.editView.text.buffer);
+                                }
+                                Interface_Object_invalidateDrawing (
+                                        &interface.editView.ruler);
+                                Interface_Object_invalidateDrawing (
+                                        &interface.editView.text);
+                                Interface_editViewText_invalidateText();
+                                break;
                         }
                 } else if (
                         keySym >> 8 == 0 && state == Window_State_on &&
@@ -407,7 +513,7 @@ void Interface_handleKey (
                 break;
         }
         
-        conditionallyRefresh(render);
+        requestRefresh();
 }
 
 /* Interface_handleKeyUp
@@ -419,18 +525,14 @@ void Interface_handleKeyUp (Window_State state) {
         if (BUFFER_EXISTS) {
                 if (interface.modKeyState.shift == Window_State_on) {
                         if (interface.modKeyState.alt == Window_State_on) {
-                                size_t column =
-                                        interface.
-                                        editView.
-                                        text.buffer->cursors[0].column;
-                                size_t row =
-                                        interface.
-                                        editView.
-                                        text.buffer->cursors[0].row;
-                                EditBuffer_Cursor_moveV (
-                                        interface.editView.text.buffer->cursors, -1);
-                                EditBuffer_addNewCursor (
-                                        interface.editView.text.buffer, column, row);
+                                EditBuffer *buffer =
+                                        interface.editView.text.buffer;
+                                EditBuffer_Cursor *primary =
+                                        EditBuffer_getPrimaryCursor(buffer);
+                                size_t column = primary->column;
+                                size_t row    = primary->row;
+                                EditBuffer_Cursor_moveV(primary, -1);
+                                EditBuffer_addNewCursor(buffer, column, row);
                         } else {
                                 EditBuffer_cursorsSelectV (
                                         interface.editView.text.buffer, -1);
@@ -453,20 +555,14 @@ void Interface_handleKeyDown (Window_State state) {
         if (BUFFER_EXISTS) {
                 if (interface.modKeyState.shift == Window_State_on) {
                         if (interface.modKeyState.alt == Window_State_on) {
-                                size_t column =
-                                        interface.
-                                        editView.
-                                        text.buffer->cursors[0].column;
-                                size_t row =
-                                        interface.
-                                        editView.
-                                        text.buffer->cursors[0].row;
-                                EditBuffer_Cursor_moveV (
-                                        interface.editView.text.buffer->cursors,
-                                        1);
-                                EditBuffer_addNewCursor (
-                                        interface.editView.text.buffer, column,
-                                        row);
+                                EditBuffer *buffer =
+                                        interface.editView.text.buffer;
+                                EditBuffer_Cursor *primary =
+                                        EditBuffer_getPrimaryCursor(buffer);
+                                size_t column = primary->column;
+                                size_t row    = primary->row;
+                                EditBuffer_Cursor_moveV(primary, 1);
+                                EditBuffer_addNewCursor(buffer, column, row);
                         } else {
                                 EditBuffer_cursorsSelectV (
                                         interface.editView.text.buffer, 1);
@@ -521,12 +617,14 @@ void Interface_handleKeyRight (Window_State state) {
         }
 }
 
-/* conditionallyRefresh
- * Refreshes the entire interface if the render parameter is 1.
+/* requestRefresh
+ * Asks for the interface to be refreshed in the next frame, if anything in it
+ * was invalidated. Handlers only ever change what is going to be drawn, so that
+ * however many events come in at once, it is only drawn once per frame.
  */
-static void conditionallyRefresh (int render) {
-        if (render) {
-                Interface_refresh();
+static void requestRefresh (void) {
+        if (Interface_needsRefresh()) {
+                Window_requestFrame();
         }
 }
 
@@ -657,7 +755,8 @@ static int checkTextClick (void) {
                         EditBuffer_clearExtraCursors (
                                 interface.editView.text.buffer);
                         EditBuffer_Cursor_moveTo (
-                                interface.editView.text.buffer->cursors,
+                                EditBuffer_getPrimaryCursor (
+                                        interface.editView.text.buffer),
                                 realX, realY);
                         Interface_Object_invalidateDrawing (
                                 &interface.editView.text);
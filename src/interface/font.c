@@ -1,5 +1,13 @@
 #include "module.h"
 #include "options.h"
+#include "utility.h"
+
+static unsigned int Interface_GlyphCache_get (
+        Interface_GlyphCache *,
+        FT_Face,
+        Rune);
+static void Interface_GlyphCache_grow (Interface_GlyphCache *);
+static size_t Interface_GlyphCache_hash (Rune, size_t);
 
 /* Interface_loadFonts
  * Initializes FreeType, loads all fonts, and gathers information about font
@@ -28,9 +36,35 @@ Error Interface_loadFonts (void) {
         interface.fonts.glyphHeight = fontExtents.ascent;
         interface.fonts.glyphWidth  = fontExtents.max_x_advance;
 
+        // rows are a whole number of pixels tall, so that scrolling can move
+        // them on screen without them landing in between pixels
+        int wholeLineHeight = (int)(interface.fonts.lineHeight);
+        if (wholeLineHeight < interface.fonts.lineHeight) {
+                interface.fonts.lineHeight = wholeLineHeight + 1;
+        }
+
+        // if the atlas can't be started, text is just drawn through cairo
+        if (Options_glyphAtlas) {
+                Interface_GlyphAtlas_start (
+                        &interface.fonts.atlasNormal,
+                        Options_fontName);
+        }
+
         return Error_none;
 }
 
+/* Interface_freeFonts
+ * Frees the glyph atlas and the glyph cache. The faces that cairo draws with
+ * are left alone, since cairo may still be holding on to them.
+ */
+void Interface_freeFonts (void) {
+        Interface_GlyphAtlas_free(&interface.fonts.atlasNormal);
+
+        free(interface.fonts.glyphsNormal.table);
+        free(interface.fonts.glyphsNormal.entries);
+        interface.fonts.glyphsNormal = (const Interface_GlyphCache) { 0 };
+}
+
 /* Interface_fontNormal
  * Sets the font to the standard normal font.
  */
@@ -39,6 +73,94 @@ void Interface_fontNormal (void) {
         cairo_set_font_face(Window_context, interface.fonts.fontFaceNormal);
 }
 
+/* Interface_getGlyphNormal
+ * Returns the index of the glyph that rune is drawn with in the normal font, or
+ * zero if the font doesn't have one. Each rune is only looked up in the font
+ * once.
+ */
+unsigned int Interface_getGlyphNormal (Rune rune) {
+        return Interface_GlyphCache_get (
+                &interface.fonts.glyphsNormal,
+                interface.fonts.freetypeFaceNormal,
+                rune);
+}
+
+/* Interface_GlyphCache_get
+ * Returns the index of the glyph for rune in face, looking it up and adding it
+ * to the cache if it isn't there yet. Runes the face doesn't have are cached
+ * as well, with a glyph index of zero.
+ */
+static unsigned int Interface_GlyphCache_get (
+        Interface_GlyphCache *cache,
+        FT_Face              face,
+        Rune                 rune
+) {
+        if (rune < INTERFACE_GLYPH_TABLE_SIZE) {
+                if (cache->table == NULL) {
+                        cache->table = calloc (
+                                INTERFACE_GLYPH_TABLE_SIZE,
+                                sizeof(unsigned int));
+                }
+                if (cache->table[rune] == 0) {
+                        cache->table[rune] =
+                                FT_Get_Char_Index(face, rune) + 1;
+                }
+                return cache->table[rune] - 1;
+        }
+
+        // empty entries have a rune of zero, which can never be in here
+        if (cache->amountOfEntries * 2 >= cache->size) {
+                Interface_GlyphCache_grow(cache);
+        }
+
+        size_t slot = Interface_GlyphCache_hash(rune, cache->size);
+        while (cache->entries[slot].rune != 0) {
+                Interface_GlyphEntry *entry = &cache->entries[slot];
+                if (entry->rune == rune) { return entry->index; }
+                slot = (slot + 1) & (cache->size - 1);
+        }
+
+        cache->entries[slot] = (Interface_GlyphEntry) {
+                .rune  = rune,
+                .index = FT_Get_Char_Index(face, rune),
+        };
+        cache->amountOfEntries ++;
+        return cache->entries[slot].index;
+}
+
+/* Interface_GlyphCache_grow
+ * Doubles the size of the hash table of a cache, putting every entry back in.
+ */
+static void Interface_GlyphCache_grow (Interface_GlyphCache *cache) {
+        Interface_GlyphEntry *entries = cache->entries;
+        size_t                size    = cache->size;
+
+        cache->size    = MAX(size * 2, 64);
+        cache->entries = calloc(cache->size, sizeof(Interface_GlyphEntry));
+
+        for (size_t index = 0; index < size; index ++) {
+                if (entries[index].rune == 0) { continue; }
+
+                size_t slot = Interface_GlyphCache_hash (
+                        entries[index].rune,
+                        cache->size);
+                while (cache->entries[slot].rune != 0) {
+                        slot = (slot + 1) & (cache->size - 1);
+                }
+                cache->entries[slot] = entries[index];
+        }
+
+        free(entries);
+}
+
+/* Interface_GlyphCache_hash
+ * Returns the slot a rune starts looking from in a hash table of size slots,
+ * which must be a power of two.
+ */
+static size_t Interface_GlyphCache_hash (Rune rune, size_t size) {
+        return (size_t)(rune * 2654435761u) & (size - 1);
+}
+
 // void Interface_fontBold (void) {
         // cairo_set_font_size(Window_context, fontSize);
         // cairo_set_font_face(Window_context, fontFaceBold);
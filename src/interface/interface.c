@@ -1,4 +1,5 @@
 #include "module.h"
+#include "options.h"
 #include "utility.h"
 
 Interface interface = { 0 };
@@ -11,7 +12,8 @@ static Error Interface_setup (void);
  */
 Error Interface_run (void) {
         Error err;
-        
+
+        Window_sharedMemory = Options_sharedMemory;
         err = Window_start();
         if (err) { return err; }
         
@@ -24,6 +26,7 @@ Error Interface_run (void) {
         
         err = Window_listen();
         Window_stop();
+        Interface_freeFonts();
 
         return err;
 }
@@ -39,6 +42,59 @@ void Interface_setEditBuffer (EditBuffer *newEditBuffer) {
         Interface_editViewText_invalidateText();
 }
 
+/* Interface_followEditBuffer
+ * Lets the interface know that lines were added onto the end of an edit buffer
+ * that used to be previousLength lines long. If its last line was on screen, it
+ * is scrolled down so that the new last line is too. Otherwise, its scroll is
+ * left alone, so whatever was being looked at stays put.
+ */
+void Interface_followEditBuffer (
+        EditBuffer *editBuffer,
+        size_t     previousLength
+) {
+        Interface_EditViewText *text = &interface.editView.text;
+
+        // the last row of the display is usually cut off partway through
+        size_t rows = MAX(text->display->height, 2) - 1;
+        if (editBuffer->scroll + rows >= previousLength) {
+                size_t bottom = 0;
+                if (editBuffer->length > rows) {
+                        bottom = editBuffer->length - rows;
+                }
+                editBuffer->scroll = MAX(editBuffer->scroll, bottom);
+        }
+
+        if (editBuffer != text->buffer) { return; }
+        Interface_Object_invalidateDrawing(&interface.editView.ruler);
+        Interface_Object_invalidateDrawing(&interface.editView.text);
+        Interface_editViewText_invalidateText();
+}
+
+/* Interface_watchFile
+ * Has the interface wait on fileDescriptor along with everything else, and
+ * call the file callback with it whenever it can be read from. It must be
+ * removed with Interface_unwatchFile before it is closed.
+ */
+Error Interface_watchFile (int fileDescriptor) {
+        return Window_addFile(fileDescriptor, Interface_handleFile);
+}
+
+/* Interface_unwatchFile
+ * Stops the interface from waiting on fileDescriptor.
+ */
+void Interface_unwatchFile (int fileDescriptor) {
+        Window_removeFile(fileDescriptor);
+}
+
+/* Interface_wake
+ * Has the interface call the wake callback on the main thread as soon as it
+ * can. This can be called from any thread, so that work done in the background
+ * doesn't have to be polled for.
+ */
+void Interface_wake (void) {
+        Window_wake();
+}
+
 /* Interface_setup
  * Initializes the interface, loading needed files and setting event handlers on
  * the windows.
@@ -55,7 +111,8 @@ static Error Interface_setup (void) {
                 (size_t)interface.width,
                 (size_t)interface.height);
                 
-        Window_interval = 500;
+        Window_interval      = 500;
+        Window_frameInterval = 16;
         Window_setTitle("Text Editor");
         
         Window_onRedraw      (Interface_handleRedraw);
@@ -63,6 +120,8 @@ static Error Interface_setup (void) {
         Window_onMouseMove   (Interface_handleMouseMove);
         Window_onInterval    (Interface_handleInterval);
         Window_onKey         (Interface_handleKey);
+        Window_onWake        (Interface_handleWake);
+        Window_onFrame       (Interface_refresh);
 
         interface.tabBar.newTabButton.redrawOnHover       = 1;
         interface.tabBar.newTabButton.redrawOnMouseButton = 1;
@@ -106,6 +165,17 @@ void Interface_refresh () {
         Interface_editView_refresh();
 }
 
+/* Interface_needsRefresh
+ * Returns 1 if anything in the interface was invalidated since the last time it
+ * was refreshed, and 0 if refreshing it wouldn't do anything.
+ */
+int Interface_needsRefresh (void) {
+        return
+                Interface_Object_isInvalid(&interface) ||
+                Interface_tabBar_needsRefresh()         ||
+                Interface_editView_needsRefresh();
+}
+
 /* Interface_invalidateLayout
  * Recursively invalidates the layout of the entire interface.
  */
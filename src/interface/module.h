@@ -14,6 +14,7 @@
 #define TEXT_COLOR        0.925, 0.937, 0.957
 #define ACCENT_COLOR      0.506, 0.631, 0.757
 #define QUIET_TEXT_COLOR  0.298, 0.337, 0.416
+#define ERROR_TEXT_COLOR  0.749, 0.380, 0.419
 
 #define RULER_COLOR               0.180, 0.204, 0.251
 #define RULER_TEXT_COLOR          0.298, 0.337, 0.416
@@ -47,6 +48,13 @@
 #define Interface_Object_invalidateDrawing(object) \
         Interface_Object_invalidateDrawingBack(TO_GENERIC(object))
 
+#define Interface_Object_damage(object) Window_damage ( \
+        (object)->x,     (object)->y, \
+        (object)->width, (object)->height)
+
+#define Interface_Object_isInvalid(object) ( \
+        (object)->needsRedraw || (object)->needsRecalculate)
+
 #define Interface_Object_detatchReferences(object) \
         Interface_Object_detatchReferencesBack(TO_GENERIC(object))
 
@@ -90,7 +98,6 @@ void Interface_editView_redraw         (void);
 void Interface_editViewRuler_redraw    (void);
 void Interface_editViewText_redraw     (void);
 void Interface_editViewText_redrawRow  (size_t);
-void Interface_editViewText_redrawRune (size_t, size_t, int *);
 
 void Interface_refresh                (void);
 void Interface_tabBar_refresh         (void);
@@ -101,6 +108,11 @@ void Interface_editView_refresh       (void);
 void Interface_editViewRuler_refresh  (void);
 void Interface_editViewText_refresh   (void);
 
+int Interface_needsRefresh          (void);
+int Interface_tabBar_needsRefresh   (void);
+int Interface_Tab_needsRefresh      (Interface_Tab *);
+int Interface_editView_needsRefresh (void);
+
 void Interface_Object_invalidateLayoutBack  (Interface_Object *);
 void Interface_Object_invalidateDrawingBack (Interface_Object *);
 void Interface_invalidateLayout             (void);
@@ -120,14 +132,28 @@ void Interface_handleKeyRight    (Window_State);
 void Interface_handleKeyLeft     (Window_State);
 void Interface_handleKeyDown     (Window_State);
 void Interface_handleKeyUp       (Window_State);
-void Interface_handleKey         (int, Window_KeySym, Rune, Window_State);
-void Interface_handleInterval    (int);
-void Interface_handleMouseMove   (int, int, int);
-void Interface_handleMouseButton (int, Window_MouseButton, Window_State);
-void Interface_handleRedraw      (int, int, int);
+void Interface_handleKey         (Window_KeySym, Rune, Window_State);
+void Interface_handleInterval    (void);
+void Interface_handleFile        (int);
+void Interface_handleWake        (void);
+void Interface_handleMouseMove   (int, int);
+void Interface_handleMouseButton (Window_MouseButton, Window_State);
+void Interface_handleRedraw      (int, int);
 
 Error Interface_loadFonts      (void);
+void  Interface_freeFonts      (void);
 void  Interface_fontNormal     (void);
+unsigned int Interface_getGlyphNormal (Rune);
+
+Error Interface_GlyphAtlas_start    (Interface_GlyphAtlas *, const char *);
+void  Interface_GlyphAtlas_free     (Interface_GlyphAtlas *);
+int   Interface_GlyphAtlas_canDraw  (Interface_GlyphAtlas *, cairo_t *);
+void  Interface_GlyphAtlas_draw     (
+        Interface_GlyphAtlas *,
+        cairo_surface_t *,
+        unsigned int,
+        double, double,
+        uint32_t);
 // void Interface_fontBold       (void);
 // void Interface_fontItalic     (void);
 // void Interface_fontBoldItalic (void);
@@ -83,6 +83,8 @@ struct Interface_Tab {
         double textY;
 
         char text[NAME_MAX + 1];
+        int  loading;
+        int  saveFailed;
 
         Interface_TabCloseButton closeButton;
 
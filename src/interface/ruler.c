@@ -24,6 +24,12 @@ void Interface_editViewRuler_redraw (void) {
         
         if (text->buffer == NULL) { return; }
 
+        Window_damage (
+                editView->x,
+                editView->y,
+                editView->innerX + ruler->width,
+                editView->height);
+
         cairo_set_source_rgb(Window_context, RULER_COLOR);
         cairo_rectangle (
                 Window_context,
@@ -51,6 +57,13 @@ void Interface_editViewRuler_redraw (void) {
 
                 y += interface.fonts.lineHeight;
         }
+
+        // the rest of the lines are still being loaded
+        if (text->buffer->load.running && y < text->y + text->height) {
+                cairo_set_source_rgb(Window_context, QUIET_TEXT_COLOR);
+                cairo_move_to(Window_context, editView->innerX, y);
+                cairo_show_text(Window_context, "...");
+        }
 }
 
 /* Interface_editViewRuler_refresh
@@ -18,12 +18,71 @@ typedef struct {
         void (*onNewTab)    (void);
         void (*onCloseTab)  (Interface_Tab *);
         void (*onSwitchTab) (Interface_Tab *);
+        void (*onInterval)  (void);
+        void (*onFile)      (int);
+        void (*onWake)      (void);
 } Interface_Callbacks;
 
+// the amount of runes in the basic multilingual plane
+#define INTERFACE_GLYPH_TABLE_SIZE 0x10000
+
+typedef struct {
+        Rune         rune;
+        unsigned int index;
+} Interface_GlyphEntry;
+
+// remembers which glyph each rune is drawn with, so that the font doesn't have
+// to be asked again every time a cell is drawn. runes in the basic
+// multilingual plane are looked up directly in table, which holds the glyph
+// index plus one, or zero if the rune hasn't been looked up yet. everything
+// else goes in entries, which is a hash table with linear probing.
+typedef struct {
+        unsigned int         *table;
+        Interface_GlyphEntry *entries;
+        size_t                amountOfEntries;
+        size_t                size;
+} Interface_GlyphCache;
+
+// a slot in a glyph atlas. slots are kept in a list from the most recently
+// used to the least, so that the one used the longest time ago can be reused
+// once the atlas is full.
+typedef struct {
+        unsigned int glyph;
+        size_t       newer;
+        size_t       older;
+} Interface_GlyphSlot;
+
+// holds pre-rasterized glyphs, so that text can be drawn by copying pixels
+// instead of going through cairo. every glyph gets a slot big enough for any
+// glyph in the face, with its coverage stored as one byte per pixel. the origin
+// of each glyph is originX pixels from the left of its slot, and baseline
+// pixels from the top. slotOfGlyph maps each glyph in the face to the slot it
+// is in, or to SIZE_MAX if it isn't in one.
+typedef struct {
+        FT_Face face;
+        int     slotWidth;
+        int     slotHeight;
+        int     originX;
+        int     baseline;
+
+        uint8_t             *pixels;
+        Interface_GlyphSlot *slots;
+        size_t               amountOfSlots;
+        size_t               slotsUsed;
+        size_t               newest;
+        size_t               oldest;
+
+        size_t *slotOfGlyph;
+        size_t  amountOfGlyphs;
+} Interface_GlyphAtlas;
+
 typedef struct {
         FT_Library         freetypeHandle;
         FT_Face            freetypeFaceNormal;
         cairo_font_face_t *fontFaceNormal;
+
+        Interface_GlyphCache glyphsNormal;
+        Interface_GlyphAtlas atlasNormal;
         
         double glyphHeight;
         double lineHeight;
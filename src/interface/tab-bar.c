@@ -22,6 +22,8 @@ void Interface_tabBar_recalculate (void) {
  * Redraws the tab bar.
  */
 void Interface_tabBar_redraw (void) {
+        Interface_Object_damage(&interface.tabBar);
+
         cairo_set_source_rgb(Window_context, TAB_BAR_COLOR);
         cairo_rectangle (
                 Window_context,
@@ -149,6 +151,13 @@ void Interface_tabBar_setActive (Interface_Tab *tab) {
         Interface_invalidateLayout();
 }
 
+/* Interface_tabBar_getFirst
+ * Returns the first tab in the tab bar, or NULL if there are no tabs.
+ */
+Interface_Tab *Interface_tabBar_getFirst (void) {
+        return interface.tabBar.tabs;
+}
+
 /* Interface_tabBar_invalidateLayout
  * Invalidates the layout of the tab bar.
  */
@@ -206,6 +215,24 @@ void Interface_tabBar_refresh (void) {
         Interface_newTabButton_refresh();
 }
 
+/* Interface_tabBar_needsRefresh
+ * Returns 1 if refreshing the tab bar would recalculate or redraw anything in
+ * it.
+ */
+int Interface_tabBar_needsRefresh (void) {
+        Interface_TabBar *tabBar = &interface.tabBar;
+        if (Interface_Object_isInvalid(tabBar))                { return 1; }
+        if (Interface_Object_isInvalid(&tabBar->newTabButton)) { return 1; }
+
+        Interface_Tab *tab = tabBar->tabs;
+        while (tab != NULL) {
+                if (Interface_Tab_needsRefresh(tab)) { return 1; }
+                tab = tab->next;
+        }
+
+        return 0;
+}
+
 /* Interface_newTabButton_recalculate
  * Recalculates the size amd position of the new tab button.
  */
@@ -240,6 +267,7 @@ void Interface_newTabButton_recalculate (void) {
  */
 void Interface_newTabButton_redraw (void) {
         Interface_NewTabButton *newTabButton = &interface.tabBar.newTabButton;
+        Interface_Object_damage(newTabButton);
 
         cairo_set_source_rgb(Window_context, TAB_BAR_COLOR);
         cairo_rectangle (
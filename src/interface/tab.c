@@ -51,6 +51,7 @@ void Interface_Tab_recalculate (Interface_Tab *tab) {
  * Redraws a single tab.
  */
 void Interface_Tab_redraw (Interface_Tab *tab) {
+        Interface_Object_damage(tab);
         cairo_push_group(Window_context);
 
         // tab background
@@ -99,8 +100,13 @@ void Interface_Tab_redraw (Interface_Tab *tab) {
                 cairo_stroke(Window_context);
         }
 
-        // text
-        if (tab == interface.tabBar.activeTab) {
+        // text. the title is dimmed while the buffer is still loading, and
+        // shown as an error if the buffer couldn't be saved.
+        if (tab->saveFailed) {
+                cairo_set_source_rgb(Window_context, ERROR_TEXT_COLOR);
+        } else if (tab->loading) {
+                cairo_set_source_rgb(Window_context, QUIET_TEXT_COLOR);
+        } else if (tab == interface.tabBar.activeTab) {
                 cairo_set_source_rgb(Window_context, ACTIVE_TAB_TEXT_COLOR);
         } else {
                 cairo_set_source_rgb(Window_context, INACTIVE_TAB_TEXT_COLOR);
@@ -129,6 +135,34 @@ void Interface_Tab_setText (Interface_Tab *tab, const char *text) {
         Utility_copyCString(tab->text, text, NAME_MAX);
 }
 
+/* Interface_Tab_setLoading
+ * Sets whether the buffer of the tab is still loading. If the tab is active,
+ * the ruler and the text are redrawn as well, since the lines of the buffer
+ * might have just been added in. The background of the edit view is left alone,
+ * since only the rows showing new lines are damaged when the text is grabbed.
+ */
+void Interface_Tab_setLoading (Interface_Tab *tab, int loading) {
+        if (tab->loading == loading) { return; }
+        tab->loading = loading;
+        Interface_Tab_invalidateDrawing(tab);
+
+        if (Interface_Tab_isActive(tab)) {
+                Interface_Object_invalidateDrawing(&interface.editView.ruler);
+                Interface_Object_invalidateDrawing(&interface.editView.text);
+                Interface_editViewText_invalidateText();
+        }
+}
+
+/* Interface_Tab_setSaveFailed
+ * Sets whether the last save of the buffer of the tab failed, so that the user
+ * can tell that nothing was written.
+ */
+void Interface_Tab_setSaveFailed (Interface_Tab *tab, int saveFailed) {
+        if (tab->saveFailed == saveFailed) { return; }
+        tab->saveFailed = saveFailed;
+        Interface_Tab_invalidateDrawing(tab);
+}
+
 /* Interface_Tab_getBufferId
  * Returns the buffer id of the tab. This can be used as a key for BufferManger.
  */
@@ -209,9 +243,16 @@ void Interface_Tab_refresh (Interface_Tab *tab) {
                 tab->needsRedraw = 0;
         }
 
-        if (tab->closeButton.needsRedraw) {
-                Interface_TabCloseButton_redraw(&tab->closeButton);
-        }
+        Interface_TabCloseButton_refresh(&tab->closeButton);
+}
+
+/* Interface_Tab_needsRefresh
+ * Returns 1 if refreshing the tab would recalculate or redraw anything in it.
+ */
+int Interface_Tab_needsRefresh (Interface_Tab *tab) {
+        return
+                Interface_Object_isInvalid(tab) ||
+                Interface_Object_isInvalid(&tab->closeButton);
 }
 
 /* Interface_Tab_getHoveredObject
@@ -236,6 +277,9 @@ Interface_Object *Interface_Tab_getHoveredObject (
  * if it needs to redrawn.
  */
 void Interface_TabCloseButton_refresh (Interface_TabCloseButton *closeButton) {
+        // the close button is laid out along with its tab
+        closeButton->needsRecalculate = 0;
+
         if (closeButton->needsRedraw) {
                 Interface_TabCloseButton_redraw(closeButton);
                 closeButton->needsRedraw = 0;
@@ -246,6 +290,7 @@ void Interface_TabCloseButton_refresh (Interface_TabCloseButton *closeButton) {
  * Redraws the tab's close button.
  */
 void Interface_TabCloseButton_redraw (Interface_TabCloseButton *closeButton) {
+        Interface_Object_damage(closeButton);
         cairo_push_group(Window_context);
         
         if (closeButton->tab == interface.tabBar.activeTab) {
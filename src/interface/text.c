@@ -1,5 +1,17 @@
 #include "module.h"
 #include "options.h"
+#include "utility.h"
+
+// the glyphs of the row being drawn
+static struct {
+        cairo_glyph_t *list;
+        size_t         size;
+} glyphs = { 0 };
+
+static int      needsRedraw (TextDisplay_Cell *);
+static int      isSelected  (TextDisplay_Cell *);
+static void     showGlyphs  (int);
+static uint32_t packColor   (double, double, double);
 
 /* Interface_editViewText_recalculate
  * Recalculates the size and position of the text.
@@ -55,6 +67,7 @@ void Interface_editViewText_redraw (void) {
         Interface_EditViewText *text     = &editView->text;
 
         if (text->buffer == NULL) {
+                Interface_Object_damage(editView);
                 Interface_fontNormal();
                 cairo_set_source_rgb(Window_context, QUIET_TEXT_COLOR);
                 cairo_move_to(Window_context, text->messageX, text->messageY);
@@ -62,156 +75,186 @@ void Interface_editViewText_redraw (void) {
                 return;
         }
 
+        // rows that only moved because the buffer scrolled are moved on screen
+        // too, instead of being drawn again. only the rows this uncovers are
+        // damaged.
+        int shiftedRows = TextDisplay_takeShift(text->display);
+        if (shiftedRows != 0) {
+                double lineHeight = interface.fonts.lineHeight;
+                Window_scrollArea (
+                        text->x, editView->innerY,
+                        (double)(text->display->width)  *
+                                interface.fonts.glyphWidth,
+                        (double)(text->display->height) * lineHeight,
+                        -shiftedRows * (int)(lineHeight));
+        }
+
+        // every cell is drawn in the same font, so it only needs to be set
+        // once
+        Interface_fontNormal();
         for (size_t y = 0; y < text->display->height; y ++) {
                 Interface_editViewText_redrawRow(y);
         }
 }
 
 /* Interface_editViewText_redrawRow
- * Redraws damaged cells at row y.
+ * Redraws damaged cells at row y. The normal font has to already be set. The
+ * row is drawn in layers, and each layer is drawn with as few cairo calls as
+ * possible: the backgrounds of each run of damaged cells are filled as one
+ * rectangle, and the glyphs of every damaged cell in the row are shown at
+ * once.
  */
 void Interface_editViewText_redrawRow (size_t y) {
         Interface_EditView     *editView = &interface.editView;
         Interface_EditViewText *text     = &editView->text;
-        int inIndent = 1;
-        
-        for (size_t x = 0; x < text->display->width; x ++) {
-                Interface_editViewText_redrawRune(x, y, &inIndent);
-        }
-}
 
-/* Interface_editViewText_redrawRow
- * Redraws the cell at column x and row y if it is damaged.
- */
-void Interface_editViewText_redrawRune (size_t x, size_t y, int *inIndent) {
-        Interface_EditView     *editView = &interface.editView;
-        Interface_EditViewText *text     = &editView->text;
-        
-        size_t coordinate = y * text->display->width + x;
-        TextDisplay_Cell *cell =
-                &text->display->cells[coordinate];
-
-        // if the cell is undamaged, we don't want to render it.
-        // however, we'll make an exception for cursors because those
-        // need to blink.
-        if (
-                !cell->damaged &&
-                cell->cursorState != TextDisplay_CursorState_cursor
-        ) { return; }
-        
-        text->display->cells[coordinate].damaged = 0;
-        
-        double realX = text->x;
-        double realY = editView->innerY;
-        realX += (double)(x) * interface.fonts.glyphWidth;
-        realY += (double)(y) * interface.fonts.lineHeight;
+        size_t            width = text->display->width;
+        TextDisplay_Cell *cells = &text->display->cells[y * width];
 
-        // background to clear what was previously there
-        cairo_set_source_rgb(Window_context, BACKGROUND_COLOR);
-        cairo_rectangle (
-                Window_context,
-                realX, realY,
-                interface.fonts.glyphWidth, interface.fonts.lineHeight);
-        cairo_fill(Window_context);
+        double glyphWidth  = interface.fonts.glyphWidth;
+        double glyphHeight = interface.fonts.glyphHeight;
+        double lineHeight  = interface.fonts.lineHeight;
+        double realY = editView->innerY + (double)(y) * lineHeight;
 
-        // draw indentation markers every tab stop
-        int isSpace = isspace((char)(cell->rune));
-        if (!isSpace) { inIndent = 0; }                
-        if (x % (size_t)(Options_tabSize) == 0 && inIndent) {
-                cairo_set_source_rgb(Window_context, RULER_COLOR);
-                cairo_set_line_width(Window_context, 2);
-                cairo_move_to(Window_context, realX + 1, realY);
-                cairo_line_to (
-                        Window_context,
-                        realX + 1,
-                        realY + interface.fonts.glyphHeight);
-                cairo_stroke(Window_context);
-        }
+        // background to clear what was previously there
+        int anyDamaged = 0;
+        for (size_t x = 0; x < width;) {
+                if (!needsRedraw(&cells[x])) {
+                        x ++;
+                        continue;
+                }
 
-        // draw 80 column marker
-        if (x == Options_columnGuide) {
-                cairo_set_source_rgb(Window_context, RULER_COLOR);
-                cairo_set_line_width(Window_context, 2);
-                cairo_move_to(Window_context, realX + 1, realY);
-                cairo_line_to (
-                        Window_context,
-                        realX + 1,
-                        realY + interface.fonts.lineHeight);
-                cairo_stroke(Window_context);
-        }
+                size_t start = x;
+                while (x < width && needsRedraw(&cells[x])) { x ++; }
 
-        // selection highlight
-        if (cell->cursorState == TextDisplay_CursorState_selection) {
-                cairo_set_source_rgb(Window_context, SELECTION_COLOR);
+                double realX = text->x + (double)(start) * glyphWidth;
+                double runWidth = (double)(x - start) * glyphWidth;
                 cairo_rectangle (
                         Window_context,
                         realX, realY,
-                        interface.fonts.glyphWidth,
-                        interface.fonts.glyphHeight);
-                cairo_fill(Window_context);
+                        runWidth, lineHeight);
+                Window_damage(realX, realY, runWidth, lineHeight);
+                anyDamaged = 1;
         }
+        if (!anyDamaged) { return; }
+        cairo_set_source_rgb(Window_context, BACKGROUND_COLOR);
+        cairo_fill(Window_context);
 
-        // don't attempt to render whitespace
-        if (cell->rune != TEXTDISPLAY_EMPTY_CELL && !isSpace) {
-                unsigned int index = FT_Get_Char_Index (
-                        interface.fonts.freetypeFaceNormal,
-                        cell->rune);
+        // indentation markers every tab stop, and the 80 column marker
+        for (size_t x = 0; x < width; x ++) {
+                TextDisplay_Cell *cell = &cells[x];
+                if (!needsRedraw(cell)) { continue; }
 
-                // if we couldn't find the character, display a red
-                // error symbol
-                if (index == 0) {
-                        cairo_set_source_rgb (
-                                Window_context,
-                                BAD_CHAR_COLOR);
-                        double scale =
-                                interface.fonts.glyphWidth / 3;
-                        double centerX =
-                                realX + interface.fonts.glyphWidth / 2;
-                        double centerY =
-                                realY + interface.fonts.glyphHeight / 2;
-                        cairo_set_line_width(Window_context, 2);
-                        cairo_move_to (
-                                Window_context,
-                                centerX - scale,
-                                centerY - scale);
+                double realX = text->x + (double)(x) * glyphWidth;
+                int    isSpace = isspace((char)(cell->rune));
+                if (x % (size_t)(Options_tabSize) == 0 && isSpace) {
+                        cairo_move_to(Window_context, realX + 1, realY);
                         cairo_line_to (
                                 Window_context,
-                                centerX + scale,
-                                centerY + scale);
-                                cairo_stroke(Window_context);
-                        cairo_move_to (
-                                Window_context,
-                                centerX + scale,
-                                centerY - scale);
+                                realX + 1,
+                                realY + glyphHeight);
+                }
+                if (x == Options_columnGuide) {
+                        cairo_move_to(Window_context, realX + 1, realY);
                         cairo_line_to (
                                 Window_context,
-                                centerX - scale,
-                                centerY + scale);
-                                cairo_stroke(Window_context);
-                        return;
+                                realX + 1,
+                                realY + lineHeight);
                 }
-                
-                cairo_glyph_t glyph = {
-                        .index = index,
-                        .x     = realX,
-                        .y     =
-                                realY +
-                                interface.fonts.glyphHeight * 0.8
-                };
-                Interface_fontNormal();
-                cairo_set_source_rgb(Window_context, TEXT_COLOR);
-                cairo_show_glyphs(Window_context, &glyph, 1);
         }
-        
-        // draw blinking cursor yayayayayayaya
-        if (
-                cell->cursorState == TextDisplay_CursorState_cursor &&
-                text->cursorBlink
-        ) {
-                cairo_set_source_rgb(Window_context, CURSOR_COLOR);
-                cairo_set_line_width (
+        cairo_set_source_rgb(Window_context, RULER_COLOR);
+        cairo_set_line_width(Window_context, 2);
+        cairo_stroke(Window_context);
+
+        // selection highlight
+        for (size_t x = 0; x < width;) {
+                if (!needsRedraw(&cells[x]) || !isSelected(&cells[x])) {
+                        x ++;
+                        continue;
+                }
+
+                size_t start = x;
+                while (
+                        x < width &&
+                        needsRedraw(&cells[x]) &&
+                        isSelected(&cells[x])
+                ) { x ++; }
+
+                cairo_rectangle (
                         Window_context,
-                        Options_cursorSize);
+                        text->x + (double)(start) * glyphWidth, realY,
+                        (double)(x - start) * glyphWidth, glyphHeight);
+        }
+        cairo_set_source_rgb(Window_context, SELECTION_COLOR);
+        cairo_fill(Window_context);
+
+        // glyphs. if we couldn't find the character, a red error symbol is
+        // drawn instead.
+        if (glyphs.size < width) {
+                glyphs.size = width;
+                glyphs.list = realloc (
+                        glyphs.list,
+                        glyphs.size * sizeof(cairo_glyph_t));
+        }
+
+        int amountOfGlyphs = 0;
+        for (size_t x = 0; x < width; x ++) {
+                TextDisplay_Cell *cell = &cells[x];
+                if (!needsRedraw(cell)) { continue; }
+
+                // don't attempt to render whitespace
+                if (cell->rune == TEXTDISPLAY_EMPTY_CELL) { continue; }
+                if (isspace((char)(cell->rune)))         { continue; }
+
+                // bytes that weren't valid UTF-8 have no glyph either
+                unsigned int index = 0;
+                if (!Unicode_isBadByte(cell->rune)) {
+                        index = Interface_getGlyphNormal(cell->rune);
+                }
+
+                double realX = text->x + (double)(x) * glyphWidth;
+                if (index != 0) {
+                        glyphs.list[amountOfGlyphs ++] = (cairo_glyph_t) {
+                                .index = index,
+                                .x     = realX,
+                                .y     = realY + glyphHeight * 0.8
+                        };
+                        continue;
+                }
+
+                double scale   = glyphWidth / 3;
+                double centerX = realX + glyphWidth  / 2;
+                double centerY = realY + glyphHeight / 2;
+                cairo_move_to (
+                        Window_context,
+                        centerX - scale,
+                        centerY - scale);
+                cairo_line_to (
+                        Window_context,
+                        centerX + scale,
+                        centerY + scale);
+                cairo_move_to (
+                        Window_context,
+                        centerX + scale,
+                        centerY - scale);
+                cairo_line_to (
+                        Window_context,
+                        centerX - scale,
+                        centerY + scale);
+        }
+        cairo_set_source_rgb(Window_context, BAD_CHAR_COLOR);
+        cairo_set_line_width(Window_context, 2);
+        cairo_stroke(Window_context);
+
+        if (amountOfGlyphs > 0) { showGlyphs(amountOfGlyphs); }
+
+        // draw blinking cursor yayayayayayaya
+        for (size_t x = 0; x < width && text->cursorBlink; x ++) {
+                if (cells[x].cursorState != TextDisplay_CursorState_cursor) {
+                        continue;
+                }
+
+                double realX = text->x + (double)(x) * glyphWidth;
                 cairo_move_to (
                         Window_context,
                         realX + (double)(Options_cursorSize) / 2,
@@ -219,9 +262,30 @@ void Interface_editViewText_redrawRune (size_t x, size_t y, int *inIndent) {
                 cairo_line_to (
                         Window_context,
                         realX + (double)(Options_cursorSize) / 2,
-                        realY + interface.fonts.glyphHeight);
-                cairo_stroke(Window_context);
+                        realY + glyphHeight);
         }
+        cairo_set_source_rgb(Window_context, CURSOR_COLOR);
+        cairo_set_line_width(Window_context, Options_cursorSize);
+        cairo_stroke(Window_context);
+
+        for (size_t x = 0; x < width; x ++) { cells[x].damaged = 0; }
+}
+
+/* needsRedraw
+ * Returns 1 if a cell needs to be drawn. Undamaged cells are left alone, except
+ * for cursors, because those need to blink.
+ */
+static int needsRedraw (TextDisplay_Cell *cell) {
+        return
+                cell->damaged ||
+                cell->cursorState == TextDisplay_CursorState_cursor;
+}
+
+/* isSelected
+ * Returns 1 if a cell is part of a selection.
+ */
+static int isSelected (TextDisplay_Cell *cell) {
+        return cell->cursorState == TextDisplay_CursorState_selection;
 }
 
 /* Interface_editViewText_invalidateText
@@ -253,3 +317,51 @@ void Interface_editViewText_refresh (void) {
                 text->needsRedraw = 0;
         }
 }
+
+/* showGlyphs
+ * Shows the first amount glyphs gathered for a row, in the text color. If the
+ * glyph atlas can draw into the window, they are copied out of it straight into
+ * the pixels of the back buffer. Otherwise, cairo shows them all at once.
+ */
+static void showGlyphs (int amount) {
+        Interface_GlyphAtlas *atlas = &interface.fonts.atlasNormal;
+        if (!Interface_GlyphAtlas_canDraw(atlas, Window_context)) {
+                cairo_set_source_rgb(Window_context, TEXT_COLOR);
+                cairo_show_glyphs(Window_context, glyphs.list, amount);
+                return;
+        }
+
+        // cairo has to finish drawing the layers under the text before the
+        // pixels are touched, and has to be told about them afterwards
+        cairo_surface_t *surface = cairo_get_target(Window_context);
+        cairo_surface_flush(surface);
+
+        uint32_t color = packColor(TEXT_COLOR);
+        for (int index = 0; index < amount; index ++) {
+                Interface_GlyphAtlas_draw (
+                        atlas, surface,
+                        (unsigned int)(glyphs.list[index].index),
+                        glyphs.list[index].x,
+                        glyphs.list[index].y,
+                        color);
+        }
+
+        // glyphs can reach past the row they are on, as far as a slot goes
+        int top = (int)(glyphs.list[0].y + 0.5) - atlas->baseline;
+        cairo_surface_mark_dirty_rectangle (
+                surface,
+                0, MAX(top, 0),
+                cairo_image_surface_get_width(surface),
+                atlas->slotHeight + MIN(top, 0));
+}
+
+/* packColor
+ * Packs a color made of three components from 0 to 1 into the layout of a
+ * pixel in the back buffer.
+ */
+static uint32_t packColor (double red, double green, double blue) {
+        return
+                (uint32_t)(red   * 255 + 0.5) << 16 |
+                (uint32_t)(green * 255 + 0.5) << 8  |
+                (uint32_t)(blue  * 255 + 0.5);
+}
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <libgen.h>
 #include "options.h"
@@ -10,11 +11,22 @@ static void   handleStart     (void);
 static void   handleSwitchTab (Interface_Tab *);
 static void   handleNewTab    (void);
 static void   handleCloseTab  (Interface_Tab *);
-static size_t openInNewTab    (char *);
+static void   handleInterval  (void);
+static void   handleFile      (int);
+static void   handleWake      (void);
+static void   updateBuffers   (void);
+static size_t openInNewTab    (char *, int);
 
 static char *filePathArgument = NULL;
+static int   followArgument   = 0;
 
 int main (int argc, char *argv[]) {
+        // -f follows the file as it grows, like tail -f
+        if (argc > 2 && strcmp(argv[1], "-f") == 0) {
+                followArgument = 1;
+                argv ++;
+                argc --;
+        }
         if (argc > 1) { filePathArgument = argv[1]; }
 
         BufferManager_init();
@@ -23,11 +35,15 @@ int main (int argc, char *argv[]) {
         Interface_onSwitchTab(handleSwitchTab);
         Interface_onNewTab(handleNewTab);
         Interface_onCloseTab(handleCloseTab);
+        Interface_onInterval(handleInterval);
+        Interface_onFile(handleFile);
+        Interface_onWake(handleWake);
+        EditBuffer_onWorkerFinish(Interface_wake);
         Interface_run();
 }
 
 static void handleStart (void) {
-        openInNewTab(filePathArgument);
+        openInNewTab(filePathArgument, followArgument);
 }
 
 static void handleSwitchTab (Interface_Tab *tab) {
@@ -37,11 +53,18 @@ static void handleSwitchTab (Interface_Tab *tab) {
 }
 
 static void handleNewTab (void) {
-        openInNewTab(NULL);
+        openInNewTab(NULL, 0);
 }
 
 static void handleCloseTab (Interface_Tab *tab) {
-        BufferManager_delete(Interface_Tab_getBufferId(tab));
+        // the inotify instance of a followed file is closed along with its
+        // buffer, so it has to be unwatched first
+        size_t      bufferId   = Interface_Tab_getBufferId(tab);
+        EditBuffer *editBuffer = BufferManager_get(bufferId);
+        if (EditBuffer_isFollowing(editBuffer)) {
+                Interface_unwatchFile(editBuffer->follow.watch);
+        }
+        BufferManager_delete(bufferId);
         
         if (Interface_Tab_isActive(tab)) {
                 Interface_Tab *switchTo = Interface_Tab_getNext(tab);
@@ -65,9 +88,57 @@ static void handleCloseTab (Interface_Tab *tab) {
         Interface_tabBar_delete(tab);
 }
 
-static size_t openInNewTab (char *path) {
+static void handleInterval (void) {
+        BufferManager_flushJournals();
+}
+
+static void handleFile (int fileDescriptor) {
+        (void)(fileDescriptor);
+        updateBuffers();
+}
+
+static void handleWake (void) {
+        // saves that just finished get their journals cleared out
+        BufferManager_flushJournals();
+        updateBuffers();
+}
+
+static void updateBuffers (void) {
+        Interface_Tab *tab = Interface_tabBar_getFirst();
+        for (; tab != NULL; tab = Interface_Tab_getNext(tab)) {
+                size_t bufferId = Interface_Tab_getBufferId(tab);
+                EditBuffer *editBuffer = BufferManager_get(bufferId);
+
+                // files that were still loading get the rest of their lines
+                // added in once they are ready
+                int loading = EditBuffer_isLoading(editBuffer);
+                if (!loading) { EditBuffer_finishLoad(editBuffer); }
+                Interface_Tab_setLoading(tab, loading);
+
+                // a save that failed is shown on its tab until one works
+                if (!EditBuffer_isSaving(editBuffer)) {
+                        Error saved = EditBuffer_finishSave(editBuffer);
+                        Interface_Tab_setSaveFailed(tab, saved != Error_none);
+                }
+
+                // followed files get whatever was written to them added on.
+                // if there was too much to read in one go, the rest is read
+                // once everything else has had a turn.
+                size_t length = editBuffer->length;
+                if (EditBuffer_updateFollow(editBuffer)) {
+                        Interface_followEditBuffer(editBuffer, length);
+                }
+                if (!loading && editBuffer->follow.behind) { Interface_wake(); }
+        }
+}
+
+static size_t openInNewTab (char *path, int follow) {
         EditBuffer *editBuffer = EditBuffer_new();
-        EditBuffer_open(editBuffer, path);
+        if (follow) {
+                EditBuffer_openFollowing(editBuffer, path);
+        } else {
+                EditBuffer_open(editBuffer, path);
+        }
         
         size_t bufferId = BufferManager_add(editBuffer);
 
@@ -76,6 +147,10 @@ static size_t openInNewTab (char *path) {
                 tabTitle = basename(path);
         }
         Interface_Tab *tab = Interface_tabBar_add(bufferId, tabTitle);
+        Interface_Tab_setLoading(tab, EditBuffer_isLoading(editBuffer));
+        if (EditBuffer_isFollowing(editBuffer)) {
+                Interface_watchFile(editBuffer->follow.watch);
+        }
 
         Interface_tabBar_setActive(tab);
         Interface_setEditBuffer(BufferManager_get(bufferId));
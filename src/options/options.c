@@ -7,6 +7,12 @@ int    Options_scrollSize;
 int    Options_cursorSize;
 int    Options_fontSize;
 char  *Options_fontName;
+size_t Options_undoLimit;
+size_t Options_journalLimit;
+size_t Options_readOnlySize;
+int    Options_sharedMemory;
+int    Options_glyphAtlas;
+size_t Options_glyphAtlasSize;
 
 /* Options_start
  * Intializes the options module.
@@ -20,4 +26,10 @@ void Options_start () {
         Options_fontSize     = 14;
         Options_fontName     =
                 "/home/sashakoshka/.local/share/fonts/DMMono-Light.ttf";
+        Options_undoLimit    = 64 * 1024 * 1024;
+        Options_journalLimit = 16 * 1024 * 1024;
+        Options_readOnlySize = 1024 * 1024 * 1024;
+        Options_sharedMemory = 1;
+        Options_glyphAtlas   = 0;
+        Options_glyphAtlasSize = 4 * 1024 * 1024;
 }
@@ -4,7 +4,8 @@
 #include "safe-string.h"
 #include "utility.h"
 
-static void String_realloc (String *, size_t);
+static void   String_realloc        (String *, size_t);
+static void   String_invalidate     (String *, size_t);
 
 /* String_new
  * Creates a new string from the specified buffer.
@@ -13,7 +14,7 @@ String *String_new (const char *buffer) {
         String *string = calloc(1, sizeof(String));
         string->length = 0;
         string->size   = string->length + 1;
-        string->buffer = calloc(string->size, sizeof(Rune));
+        string->buffer = calloc(string->size, sizeof(char));
 
         String_addBuffer(string, buffer);
         return string;
@@ -23,6 +24,7 @@ String *String_new (const char *buffer) {
  * Frees a string from memory.
  */
 void String_free (String *string) {
+        free(string->checkpoints);
         free(string->buffer);
         free(string);
 }
@@ -31,21 +33,122 @@ void String_free (String *string) {
  * Resets a string, clearing all text inside of it.
  */
 void String_clear (String *string) {
-        string->length = 0;
-        string->size   = string->length + 1;
-        string->buffer = realloc(string->buffer, string->size);
+        string->length     = 0;
+        string->byteLength = 0;
+        String_invalidate(string, 0);
+}
+
+/* String_getRune
+ * Returns the rune at position. If position is larger than or equal to the
+ * string length, this function returns zero.
+ */
+Rune String_getRune (String *string, size_t position) {
+        if (position >= string->length) { return 0; }
+
+        size_t offset = String_getOffset(string, position);
+        uint8_t *bytes = (uint8_t *)(string->buffer + offset);
+        if (bytes[0] < 0x80) { return bytes[0]; }
+
+        return Unicode_utf8ArrayToRune (
+                bytes,
+                Unicode_utf8CodepointSize(bytes[0]));
+}
+
+/* String_getOffset
+ * Returns the byte offset of the rune at position. If position is equal to the
+ * string length, the offset of the end of the string is returned.
+ */
+size_t String_getOffset (String *string, size_t position) {
+        // if the string is pure ASCII, there is nothing to look up
+        if (string->byteLength == string->length) { return position; }
+        if (position >= string->length) { return string->byteLength; }
+
+        size_t checkpoint = position / STRING_CHECKPOINT_INTERVAL;
+
+        // make sure the checkpoints are indexed up to the one we need
+        if (checkpoint >= string->checkpointsSize) {
+                string->checkpointsSize = checkpoint + 1;
+                if (string->checkpointsSize < string->length / 32) {
+                        string->checkpointsSize = string->length / 32;
+                }
+                string->checkpoints = realloc (
+                        string->checkpoints,
+                        string->checkpointsSize * sizeof(size_t));
+        }
+
+        if (string->checkpointsValid == 0) {
+                string->checkpoints[0]   = 0;
+                string->checkpointsValid = 1;
+        }
+
+        while (string->checkpointsValid <= checkpoint) {
+                size_t offset =
+                        string->checkpoints[string->checkpointsValid - 1];
+                for (
+                        size_t index = 0;
+                        index < STRING_CHECKPOINT_INTERVAL;
+                        index ++
+                ) {
+                        offset += Unicode_utf8CodepointSize (
+                                (uint8_t)(string->buffer[offset]));
+                }
+                string->checkpoints[string->checkpointsValid] = offset;
+                string->checkpointsValid ++;
+        }
+
+        // start from the cached position instead if it is closer
+        size_t index  = checkpoint * STRING_CHECKPOINT_INTERVAL;
+        size_t offset = string->checkpoints[checkpoint];
+        if (string->cachedIndex <= position && string->cachedIndex > index) {
+                index  = string->cachedIndex;
+                offset = string->cachedOffset;
+        }
+
+        for (; index < position; index ++) {
+                offset += Unicode_utf8CodepointSize (
+                        (uint8_t)(string->buffer[offset]));
+        }
+
+        string->cachedIndex  = position;
+        string->cachedOffset = offset;
+        return offset;
 }
 
 /* String_addBuffer
  * Appends a buffer of chars to the end of a string.
  */
 void String_addBuffer (String *string, const char *buffer) {
-        for (int index = 0; buffer[index];) {
-                size_t amountGot = 0;
-                Rune rune = Unicode_utf8ToRune(buffer + index, &amountGot);
-                index    += (int)(amountGot);
-                
-                String_addRune(string, rune);
+        String_addBytes(string, buffer, strlen(buffer));
+}
+
+/* String_addBytes
+ * Appends length bytes of UTF-8 text to the end of a string. Unlike
+ * String_addBuffer, the text does not need to be null terminated. Bytes that do
+ * not form a complete, valid codepoint are each stored as a bad byte rune (see
+ * Unicode_badByteToRune) so they can be shown as errors.
+ */
+void String_addBytes (String *string, const char *buffer, size_t length) {
+        // copy over valid stretches of text all at once
+        for (size_t index = 0; index < length;) {
+                size_t amountOfRunes;
+                size_t runLength = Unicode_utf8Validate (
+                        buffer + index,
+                        length - index,
+                        &amountOfRunes);
+
+                String_addValidBytes (
+                        string,
+                        buffer + index,
+                        runLength,
+                        amountOfRunes);
+                index += runLength;
+
+                if (index < length) {
+                        String_addRune (
+                                string,
+                                Unicode_badByteToRune(buffer[index]));
+                        index ++;
+                }
         }
 }
 
@@ -53,20 +156,66 @@ void String_addBuffer (String *string, const char *buffer) {
  * Appends another string to the end of a string.
  */
 void String_addString (String *string, String *addition) {
-        size_t previousEnd = string->length;
-        String_realloc(string, string->length + addition->length);
+        String_addValidBytes (
+                string,
+                addition->buffer,
+                addition->byteLength,
+                addition->length);
+}
+
+/* String_addValidBytes
+ * Appends length bytes of text, containing amountOfRunes runes, to the end of
+ * the string. The text must already be known to be valid UTF-8, such as text
+ * taken out of another string, so it is never turned into bad byte runes.
+ */
+void String_addValidBytes (
+        String     *string,
+        const char *buffer,
+        size_t     length,
+        size_t     amountOfRunes
+) {
+        if (length == 0) { return; }
+
+        String_realloc(string, string->byteLength + length);
+        memcpy(string->buffer + string->byteLength, buffer, length);
+
+        string->byteLength += length;
+        string->length     += amountOfRunes;
+}
 
-        for (size_t index = 0; index < addition->length; index ++) {
-                string->buffer[previousEnd + index] = addition->buffer[index];
+/* String_addByteRange
+ * Appends the part of another string that goes from the byte offset start up to
+ * the byte offset end. Both offsets must be on rune boundaries.
+ */
+void String_addByteRange (
+        String *string,
+        String *source,
+        size_t start,
+        size_t end
+) {
+        // if every rune in the source is a single byte, there is no need to
+        // count them
+        size_t amountOfRunes = end - start;
+        if (source->byteLength != source->length) {
+                amountOfRunes = Unicode_utf8CountRunes (
+                        source->buffer + start,
+                        end - start);
         }
+
+        String_addValidBytes (
+                string,
+                source->buffer + start,
+                end - start,
+                amountOfRunes);
 }
 
 /* String_addRune
  * Appends a single rune to the end of a string.
  */
 void String_addRune (String *string, Rune rune) {
-        String_realloc(string, string->length + 1);
-        string->buffer[string->length - 1] = rune;
+        uint8_t parts[4];
+        size_t codepointSize = Unicode_runeToUtf8(rune, parts);
+        String_addValidBytes(string, (const char *)(parts), codepointSize, 1);
 }
 
 /* String_insertBuffer
@@ -80,10 +229,10 @@ void String_addRune (String *string, Rune rune) {
         // size_t     position
 // ) {
         // if (position > string->length) { return; }
-// 
+//
         // size_t bufferLength = strlen(buffer);
         // String_realloc(string, string->length + bufferLength);
-        // 
+        //
         // for (size_t index = 0; index < bufferLength; index ++) {
                 // string->buffer[position + index + bufferLength] =
                         // string->buffer[position + index];
@@ -101,14 +250,20 @@ void String_insertString (
         size_t position
 ) {
         if (position > string->length) { return; }
-        
-        String_realloc(string, string->length + addition->length);
-        
-        for (size_t index = 0; index < addition->length; index ++) {
-                string->buffer[position + index + addition->length] =
-                        string->buffer[position + index];
-                string->buffer[position + index] = addition->buffer[index];
-        }
+
+        size_t offset = String_getOffset(string, position);
+        size_t amount = addition->byteLength;
+        String_realloc(string, string->byteLength + amount);
+
+        memmove (
+                string->buffer + offset + amount,
+                string->buffer + offset,
+                string->byteLength - offset);
+        memcpy(string->buffer + offset, addition->buffer, amount);
+
+        string->byteLength += amount;
+        string->length     += addition->length;
+        String_invalidate(string, position);
 }
 
 /* String_insertRune
@@ -117,15 +272,21 @@ void String_insertString (
  */
 void String_insertRune (String *string, Rune rune, size_t position) {
         if (position > string->length) { return; }
-        
-        String_realloc(string, string->length + 1);
-
-        Rune new = rune;
-        for (size_t index = position; index < string->size; index ++) {
-                Rune previous = string->buffer[index];
-                string->buffer[index] = new;
-                new = previous;
-        }
+
+        uint8_t parts[4];
+        size_t amount = Unicode_runeToUtf8(rune, parts);
+        size_t offset = String_getOffset(string, position);
+        String_realloc(string, string->byteLength + amount);
+
+        memmove (
+                string->buffer + offset + amount,
+                string->buffer + offset,
+                string->byteLength - offset);
+        memcpy(string->buffer + offset, parts, amount);
+
+        string->byteLength += amount;
+        string->length     += 1;
+        String_invalidate(string, position);
 }
 
 /* String_deleteRune
@@ -148,44 +309,84 @@ void String_deleteRange (String *string, size_t start, size_t end) {
         }
         if (end >= string->length) { return; }
 
-        end += 1;
-        size_t offset = end - start;
-        for (size_t index = end; index < string->length; index ++) {
-                string->buffer[index - offset] = string->buffer[index];
-        }
+        size_t startOffset = String_getOffset(string, start);
+        size_t endOffset   = String_getOffset(string, end + 1);
+
+        memmove (
+                string->buffer + startOffset,
+                string->buffer + endOffset,
+                string->byteLength - endOffset);
 
-        String_realloc(string, string->length - offset);
+        string->byteLength -= endOffset - startOffset;
+        string->length     -= end + 1 - start;
+        String_invalidate(string, start);
+        String_realloc(string, string->byteLength);
 }
 
 /* String_splitInto
  * Removes all characters after point (inclusive), and adds them to destination.
  */
 void String_splitInto (String *string, String *destination, size_t point) {
-        for (size_t index = point; index < string->length; index ++) {
-                String_addRune(destination, string->buffer[index]);
+        if (point > string->length) { return; }
+
+        size_t offset = String_getOffset(string, point);
+        String_addValidBytes (
+                destination,
+                string->buffer + offset,
+                string->byteLength - offset,
+                string->length - point);
+
+        string->byteLength = offset;
+        string->length     = point;
+        String_invalidate(string, point);
+        String_realloc(string, string->byteLength);
+}
+
+/* String_invalidate
+ * Discards any cached rune offsets that come after position. This must be
+ * called whenever the text at or after position changes.
+ */
+static void String_invalidate (String *string, size_t position) {
+        // the checkpoint at position itself is still correct, since only the
+        // text after it moved.
+        size_t checkpointsValid = position / STRING_CHECKPOINT_INTERVAL + 1;
+        if (checkpointsValid < string->checkpointsValid) {
+                string->checkpointsValid = checkpointsValid;
+        }
+
+        if (string->cachedIndex > position) {
+                string->cachedIndex  = 0;
+                string->cachedOffset = 0;
         }
 
-        String_realloc(string, point);
+        // if the string is ASCII now, we don't need the checkpoints at all
+        if (string->byteLength == string->length) {
+                free(string->checkpoints);
+                string->checkpoints      = NULL;
+                string->checkpointsSize  = 0;
+                string->checkpointsValid = 0;
+        }
 }
 
 /* String_realloc
- * Resizes the internal buffer of the string to accomodate a string of
- * newLength, excluding the null terminator.
+ * Resizes the internal buffer of the string to hold at least newByteLength
+ * bytes. The buffer grows by doubling, and only shrinks once most of it is
+ * unused, so that editing a line does not reallocate it on every keystroke.
  */
-static void String_realloc (String *string, size_t newLength) {
-        if (newLength == string->length) { return; }
+static void String_realloc (String *string, size_t newByteLength) {
+        size_t newSize = string->size;
 
-        if (newLength < string->size) {
-                // if the string is shrinking, just set the size to the new
-                // size.
-                string->size = newLength;
-        } else {
+        if (newByteLength > string->size) {
                 // try multiplying the current size by 2
-                string->size *= 2;
+                newSize *= 2;
                 // if that isn't enough, just exactly match the new size.
-                if (newLength > string->size) { string->size = newLength; }
+                if (newByteLength > newSize) { newSize = newByteLength; }
+        } else if (newByteLength < string->size / 4 && string->size > 64) {
+                newSize = MAX(newByteLength * 2, 16);
         }
-        
-        string->buffer = realloc(string->buffer, string->size * sizeof(Rune));
-        string->length = newLength;
+
+        if (newSize == string->size) { return; }
+
+        string->size   = newSize;
+        string->buffer = realloc(string->buffer, string->size);
 }
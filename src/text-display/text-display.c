@@ -4,9 +4,33 @@
 
 #include "text-display.h"
 #include "options.h"
+#include "utility.h"
 
-static void TextDisplay_grabRow (TextDisplay *, size_t);
-static void TextDisplay_clear   (TextDisplay *);
+static int  TextDisplay_grabRow        (TextDisplay *, size_t);
+static void TextDisplay_clear          (TextDisplay *);
+static void TextDisplay_allocate       (TextDisplay *);
+static void TextDisplay_moveRows       (TextDisplay *, EditBuffer_Changes *);
+static void TextDisplay_moveCell (
+        TextDisplay_Cell *,
+        TextDisplay_Cell *,
+        TextDisplay_Cell *);
+static void TextDisplay_shift          (TextDisplay *);
+static void TextDisplay_damageRow      (TextDisplay *, size_t);
+static void TextDisplay_findSpans      (TextDisplay *);
+static void TextDisplay_markSpanRows   (TextDisplay *, TextDisplay_Spans *);
+static void TextDisplay_addSpan (
+        TextDisplay_Spans *,
+        size_t,
+        size_t, size_t);
+static void TextDisplay_sortSpans      (TextDisplay *, TextDisplay_Spans *);
+static void TextDisplay_mergeSpans     (TextDisplay_Spans *);
+static int  TextDisplay_compareSpans   (const void *, const void *);
+static void TextDisplay_markEndRows    (TextDisplay *, EditBuffer_Changes *);
+static int  TextDisplay_findPreviousRow (
+        TextDisplay *,
+        EditBuffer_Changes *,
+        size_t,
+        size_t *);
 
 /* TextDisplay_new
  * Creates a new text display that is modeled after editBuffer, has a width of
@@ -24,7 +48,7 @@ TextDisplay *TextDisplay_new (
         textDisplay->width  = width;
         textDisplay->height = height;
 
-        textDisplay->cells = calloc(width * height, sizeof(TextDisplay_Cell));
+        TextDisplay_allocate(textDisplay);
         return textDisplay;
 }
 
@@ -33,20 +57,410 @@ TextDisplay *TextDisplay_new (
  */
 void TextDisplay_free (TextDisplay *textDisplay) {
         free(textDisplay->cells);
+        free(textDisplay->previousCells);
+        free(textDisplay->dirtyRows);
+        free(textDisplay->cursorRows);
+        free(textDisplay->cursorSpans.spans);
+        free(textDisplay->cursorSpans.rowStarts);
+        free(textDisplay->selectionSpans.spans);
+        free(textDisplay->selectionSpans.rowStarts);
         free(textDisplay);
 }
 
 /* TextDisplay_grab
- * Updates the contents of a text display, reflecting its model.
+ * Updates the contents of a text display, reflecting its model. Only rows that
+ * show lines that have changed since the last grab, or that have cursors or
+ * selections on them, are grabbed. Rows that still show the same line, but at a
+ * different place (because of scrolling, or lines being added or removed above
+ * them) are moved instead. If the model only scrolled, the rows that moved are
+ * left undamaged, and the distance they moved is added up, to be taken with
+ * TextDisplay_takeShift.
  */
 void TextDisplay_grab (TextDisplay *textDisplay) {
         if (textDisplay->model == NULL) {
                 TextDisplay_clear(textDisplay);
                 return;
         }
-                        
+
+        EditBuffer_Changes changes;
+        EditBuffer_takeChanges(textDisplay->model, &changes);
+
+        if (changes.all || textDisplay->needsFullGrab) {
+                memset(textDisplay->dirtyRows, 1, textDisplay->height);
+                textDisplay->needsFullGrab = 0;
+        } else {
+                memset(textDisplay->dirtyRows, 0, textDisplay->height);
+                TextDisplay_moveRows(textDisplay, &changes);
+                TextDisplay_markEndRows(textDisplay, &changes);
+        }
+
+        // rows with cursors on them always need to be grabbed
+        TextDisplay_findSpans(textDisplay);
+        TextDisplay_markSpanRows(textDisplay, &textDisplay->cursorSpans);
+        TextDisplay_markSpanRows(textDisplay, &textDisplay->selectionSpans);
+
         for (size_t row = 0; row < textDisplay->height; row ++) {
-                TextDisplay_grabRow(textDisplay, row);
+                if (textDisplay->dirtyRows[row]) {
+                        int hasCursors = TextDisplay_grabRow(textDisplay, row);
+                        textDisplay->cursorRows[row] = (uint8_t)(hasCursors);
+                } else {
+                        // rows with cursors on them are always dirty
+                        textDisplay->cursorRows[row] = 0;
+                }
+        }
+
+        textDisplay->grabbedScroll = textDisplay->model->scroll;
+}
+
+/* TextDisplay_takeShift
+ * Returns how many rows everything has moved up by since the last time this was
+ * called, or down if it is negative, and starts counting again from zero. What
+ * is on screen has to be moved by that many rows before damaged cells are drawn
+ * over it, since the cells that moved along with it aren't damaged. Whatever is
+ * uncovered by moving it is damaged.
+ */
+int TextDisplay_takeShift (TextDisplay *textDisplay) {
+        int shiftedRows = textDisplay->shiftedRows;
+        textDisplay->shiftedRows = 0;
+        return shiftedRows;
+}
+
+/* TextDisplay_moveRows
+ * Moves rows of cells to where the lines they show are now, according to the
+ * changes made to the model and how far it has scrolled since it was last
+ * grabbed. Cells are only marked as damaged if they are different from what was
+ * there before. Rows that show lines which have changed, or weren't on screen
+ * before, are marked dirty. So are rows whose lines had cursors on them, since
+ * those might have moved. If the model only scrolled, every row moves the same
+ * distance, so what is on screen can be moved along with the rows instead of
+ * being drawn again.
+ */
+static void TextDisplay_moveRows (
+        TextDisplay        *textDisplay,
+        EditBuffer_Changes *changes
+) {
+        size_t width = textDisplay->width;
+        size_t previousRow;
+
+        int shifting =
+                !changes->changed &&
+                textDisplay->model->scroll != textDisplay->grabbedScroll;
+        if (shifting) { TextDisplay_shift(textDisplay); }
+
+        // we only need to copy the cells if anything is actually moving
+        int moving = 0;
+        for (size_t row = 0; row < textDisplay->height; row ++) {
+                int found = TextDisplay_findPreviousRow (
+                        textDisplay, changes,
+                        row, &previousRow);
+                if (found && previousRow != row) {
+                        moving = 1;
+                        break;
+                }
+        }
+
+        if (moving) {
+                memcpy (
+                        textDisplay->previousCells,
+                        textDisplay->cells,
+                        width * textDisplay->height * sizeof(TextDisplay_Cell));
+        }
+
+        for (size_t row = 0; row < textDisplay->height; row ++) {
+                int found = TextDisplay_findPreviousRow (
+                        textDisplay, changes,
+                        row, &previousRow);
+                if (!found || textDisplay->cursorRows[previousRow]) {
+                        textDisplay->dirtyRows[row] = 1;
+                }
+                if (!found) {
+                        // this row is uncovered once the screen is moved
+                        if (shifting) {
+                                TextDisplay_damageRow(textDisplay, row);
+                        }
+                        continue;
+                }
+
+                // lines might have been added or removed above this one, so
+                // the real row of each cell needs to be adjusted
+                size_t line         = row + textDisplay->model->scroll;
+                size_t previousLine = previousRow + textDisplay->grabbedScroll;
+
+                for (size_t column = 0; column < width; column ++) {
+                        TextDisplay_Cell *cell =
+                                &textDisplay->cells[row * width + column];
+
+                        // if the screen is moved too, the old cell moves
+                        // along with the new one and is out of the way
+                        TextDisplay_Cell *new = &textDisplay->previousCells [
+                                previousRow * width + column];
+                        TextDisplay_Cell *old = &textDisplay->previousCells [
+                                row * width + column];
+                        if (shifting) { old = new; }
+
+                        if (previousRow != row) {
+                                TextDisplay_moveCell(cell, old, new);
+                        }
+
+                        cell->realRow = cell->realRow - previousLine + line;
+                }
+        }
+}
+
+/* TextDisplay_moveCell
+ * Replaces cell, which used to contain old, with new. It is only marked as
+ * damaged if new is different from what is on screen.
+ */
+static void TextDisplay_moveCell (
+        TextDisplay_Cell *cell,
+        TextDisplay_Cell *old,
+        TextDisplay_Cell *new
+) {
+        // what is on screen right now is the old cell, unless it was already
+        // damaged
+        uint8_t damaged =
+                old->damaged                        ||
+                old->rune        != new->rune        ||
+                old->cursorState != new->cursorState;
+
+        *cell = *new;
+        cell->damaged = damaged;
+}
+
+/* TextDisplay_shift
+ * Adds how far the model has scrolled since it was last grabbed onto the rows
+ * shifted so far. Moving by the height of the display or more uncovers all of
+ * it, so it is never counted past that.
+ */
+static void TextDisplay_shift (TextDisplay *textDisplay) {
+        size_t scroll   = textDisplay->model->scroll;
+        size_t previous = textDisplay->grabbedScroll;
+        int    height   = (int)(textDisplay->height);
+
+        if (scroll > previous) {
+                textDisplay->shiftedRows += (int)(MIN (
+                        scroll - previous,
+                        textDisplay->height));
+        } else {
+                textDisplay->shiftedRows -= (int)(MIN (
+                        previous - scroll,
+                        textDisplay->height));
+        }
+
+        textDisplay->shiftedRows = MAX(textDisplay->shiftedRows, -height);
+        textDisplay->shiftedRows = MIN(textDisplay->shiftedRows,  height);
+}
+
+/* TextDisplay_damageRow
+ * Marks every cell of a row as damaged.
+ */
+static void TextDisplay_damageRow (TextDisplay *textDisplay, size_t row) {
+        TextDisplay_Cell *cells = &textDisplay->cells[row * textDisplay->width];
+        for (size_t column = 0; column < textDisplay->width; column ++) {
+                cells[column].damaged = 1;
+        }
+}
+
+/* TextDisplay_findPreviousRow
+ * Finds the row that the line currently at row was shown on when the model was
+ * last grabbed, and stores it in previousRow. If the line has changed since
+ * then or wasn't on screen, this function returns zero.
+ */
+static int TextDisplay_findPreviousRow (
+        TextDisplay        *textDisplay,
+        EditBuffer_Changes *changes,
+        size_t             row,
+        size_t             *previousRow
+) {
+        size_t line = row + textDisplay->model->scroll;
+
+        if (changes->changed && line >= changes->start) {
+                if (line < changes->newEnd) { return 0; }
+                line = line - changes->newEnd + changes->oldEnd;
+        }
+
+        if (line < textDisplay->grabbedScroll) { return 0; }
+        *previousRow = line - textDisplay->grabbedScroll;
+        return *previousRow < textDisplay->height;
+}
+
+/* TextDisplay_findSpans
+ * Works out which columns of each row of the display have cursors on them, and
+ * which ranges are selected, so that grabbing a row doesn't have to ask the
+ * model about every single cell.
+ */
+static void TextDisplay_findSpans (TextDisplay *textDisplay) {
+        EditBuffer *model  = textDisplay->model;
+        size_t      scroll = model->scroll;
+        size_t      height = textDisplay->height;
+
+        textDisplay->cursorSpans.amount    = 0;
+        textDisplay->selectionSpans.amount = 0;
+
+        for (size_t index = 0; index < model->amountOfCursors; index ++) {
+                EditBuffer_Cursor *cursor = &model->cursors[index];
+
+                if (!cursor->hasSelection) {
+                        if (cursor->row < scroll)           { continue; }
+                        if (cursor->row - scroll >= height) { continue; }
+                        TextDisplay_addSpan (
+                                &textDisplay->cursorSpans,
+                                cursor->row - scroll,
+                                cursor->column, cursor->column);
+                        continue;
+                }
+
+                size_t startColumn;
+                size_t startRow;
+                size_t endColumn;
+                size_t endRow;
+                EditBuffer_Cursor_getSelectionBounds (
+                        cursor,
+                        &startColumn, &startRow,
+                        &endColumn,   &endRow);
+
+                // add a span for every row of the selection that is on screen
+                if (endRow < scroll) { continue; }
+                size_t row = MAX(startRow, scroll);
+                for (; row <= endRow && row - scroll < height; row ++) {
+                        TextDisplay_addSpan (
+                                &textDisplay->selectionSpans,
+                                row - scroll,
+                                row == startRow ? startColumn : 0,
+                                row == endRow   ? endColumn   : SIZE_MAX);
+                }
+        }
+
+        TextDisplay_sortSpans(textDisplay, &textDisplay->cursorSpans);
+        TextDisplay_mergeSpans(&textDisplay->selectionSpans);
+        TextDisplay_sortSpans(textDisplay, &textDisplay->selectionSpans);
+}
+
+/* TextDisplay_addSpan
+ * Adds a span to the end of a list of spans.
+ */
+static void TextDisplay_addSpan (
+        TextDisplay_Spans *spans,
+        size_t row,
+        size_t start, size_t end
+) {
+        if (spans->amount >= spans->size) {
+                spans->size = MAX(spans->size * 2, 16);
+                spans->spans = realloc (
+                        spans->spans,
+                        spans->size * sizeof(TextDisplay_Span));
+        }
+
+        spans->spans[spans->amount] = (TextDisplay_Span) {
+                .row   = row,
+                .start = start,
+                .end   = end
+        };
+        spans->amount ++;
+}
+
+/* TextDisplay_sortSpans
+ * Sorts a list of spans by row and column, and finds where each row starts.
+ */
+static void TextDisplay_sortSpans (
+        TextDisplay       *textDisplay,
+        TextDisplay_Spans *spans
+) {
+        if (spans->amount > 0) {
+                qsort (
+                        spans->spans, spans->amount,
+                        sizeof(TextDisplay_Span),
+                        TextDisplay_compareSpans);
+        }
+
+        size_t index = 0;
+        for (size_t row = 0; row <= textDisplay->height; row ++) {
+                while (index < spans->amount && spans->spans[index].row < row) {
+                        index ++;
+                }
+                spans->rowStarts[row] = index;
+        }
+}
+
+/* TextDisplay_mergeSpans
+ * Sorts a list of spans, and merges together any that overlap or touch. This
+ * way, there is only ever one span to check any given cell against.
+ */
+static void TextDisplay_mergeSpans (TextDisplay_Spans *spans) {
+        if (spans->amount == 0) { return; }
+
+        qsort (
+                spans->spans, spans->amount,
+                sizeof(TextDisplay_Span),
+                TextDisplay_compareSpans);
+
+        size_t merged = 0;
+        for (size_t index = 1; index < spans->amount; index ++) {
+                TextDisplay_Span *last = &spans->spans[merged];
+                TextDisplay_Span *span = &spans->spans[index];
+
+                int touching =
+                        span->row == last->row &&
+                        (last->end == SIZE_MAX || span->start <= last->end + 1);
+                if (touching) {
+                        last->end = MAX(last->end, span->end);
+                } else {
+                        merged ++;
+                        spans->spans[merged] = *span;
+                }
+        }
+
+        spans->amount = merged + 1;
+}
+
+/* TextDisplay_compareSpans
+ * Compares two spans by row, and then by column. This is used with qsort.
+ */
+static int TextDisplay_compareSpans (const void *left, const void *right) {
+        const TextDisplay_Span *leftSpan  = left;
+        const TextDisplay_Span *rightSpan = right;
+
+        if (leftSpan->row   != rightSpan->row) {
+                return leftSpan->row < rightSpan->row ? -1 : 1;
+        }
+        if (leftSpan->start != rightSpan->start) {
+                return leftSpan->start < rightSpan->start ? -1 : 1;
+        }
+        return 0;
+}
+
+/* TextDisplay_markSpanRows
+ * Marks every row that has a span on it as dirty.
+ */
+static void TextDisplay_markSpanRows (
+        TextDisplay       *textDisplay,
+        TextDisplay_Spans *spans
+) {
+        for (size_t index = 0; index < spans->amount; index ++) {
+                textDisplay->dirtyRows[spans->spans[index].row] = 1;
+        }
+}
+
+/* TextDisplay_markEndRows
+ * The rows after the end of the model point to the last line in it, and mirror
+ * its columns if it is on screen. Since they are cheap to grab, they are just
+ * marked dirty whenever the model changed or scrolled at all.
+ */
+static void TextDisplay_markEndRows (
+        TextDisplay        *textDisplay,
+        EditBuffer_Changes *changes
+) {
+        size_t scroll = textDisplay->model->scroll;
+        size_t length = textDisplay->model->length;
+
+        int scrolled = scroll != textDisplay->grabbedScroll;
+        if (!changes->changed && !scrolled) { return; }
+
+        size_t endRow = 0;
+        if (length > scroll) { endRow = length - scroll; }
+
+        for (size_t row = endRow; row < textDisplay->height; row ++) {
+                textDisplay->dirtyRows[row] = 1;
         }
 }
 
@@ -54,17 +468,27 @@ void TextDisplay_grab (TextDisplay *textDisplay) {
  * Updates a single row of a text display, reflecting its model. The row is
  * relative to the text display, not its model - the position of the text
  * display relative to the model is automatically determined based on the scroll
- * value.
+ * value. Returns 1 if any cell in the row has a cursor or selection on it.
  */
- // TODO: optimize this function, it seems to be incredibly slow!
-static void TextDisplay_grabRow (TextDisplay *textDisplay, size_t row) {
+static int TextDisplay_grabRow (TextDisplay *textDisplay, size_t row) {
         size_t scroll = textDisplay->model->scroll;
         size_t realRow = row + scroll;
+        int    hasCursors = 0;
 
-        String *line = NULL;
-        if (realRow < textDisplay->model->length) {
-                line = textDisplay->model->lines[realRow];
-        }
+        // rows after the end of the model use the columns of the last line
+        size_t lastLine = textDisplay->model->length - 1;
+        int    lastLineVisible =
+                lastLine >= scroll && lastLine - scroll < textDisplay->height;
+
+        String *line = EditBuffer_peekLine(textDisplay->model, realRow);
+
+        // the cursors and selections on this row, in order
+        TextDisplay_Spans *cursors    = &textDisplay->cursorSpans;
+        TextDisplay_Spans *selections = &textDisplay->selectionSpans;
+        size_t cursorIndex    = cursors->rowStarts[row];
+        size_t cursorEnd      = cursors->rowStarts[row + 1];
+        size_t selectionIndex = selections->rowStarts[row];
+        size_t selectionEnd   = selections->rowStarts[row + 1];
         
         size_t realColumn      = 0;
         int    findNextTabStop = 0;
@@ -84,7 +508,7 @@ static void TextDisplay_grabRow (TextDisplay *textDisplay, size_t row) {
                         new = ' ';
                 } else if (line != NULL && realColumn < line->length) {
                         // if the cell actually maps to a rune, get it
-                        new = line->buffer[realColumn];
+                        new = String_getRune(line, realColumn);
                         isOwnRune = 1;
                 }
 
@@ -99,19 +523,28 @@ static void TextDisplay_grabRow (TextDisplay *textDisplay, size_t row) {
                         new = ' ';
                 }
 
-                // get cursor state
+                // get cursor state. since realColumn only ever goes up, we
+                // can walk through the spans on this row alongside it.
+                while (
+                        selectionIndex < selectionEnd &&
+                        selections->spans[selectionIndex].end < realColumn
+                ) { selectionIndex ++; }
+                while (
+                        cursorIndex < cursorEnd &&
+                        cursors->spans[cursorIndex].start < realColumn
+                ) { cursorIndex ++; }
+
+                int hasSelection =
+                        selectionIndex < selectionEnd &&
+                        selections->spans[selectionIndex].start <= realColumn;
+                int hasCursor =
+                        cursorIndex < cursorEnd &&
+                        cursors->spans[cursorIndex].start == realColumn;
+
                 TextDisplay_CursorState cursorState;
-                if (
-                        isOwnRune && EditBuffer_hasSelectionAt (
-                                textDisplay->model,
-                                realColumn, realRow)
-                ) {
+                if (isOwnRune && hasSelection) {
                         cursorState = TextDisplay_CursorState_selection;
-                } else if (
-                         isOwnRune && EditBuffer_hasCursorAt (
-                                textDisplay->model,
-                                realColumn, realRow)
-                ) {
+                } else if (isOwnRune && hasCursor) {
                         cursorState = TextDisplay_CursorState_cursor;
                 } else {
                         cursorState = TextDisplay_CursorState_none;
@@ -124,13 +557,18 @@ static void TextDisplay_grabRow (TextDisplay *textDisplay, size_t row) {
                 cell->damaged    |= damaged;
                 cell->rune        = new;
                 cell->cursorState = cursorState;
+                hasCursors |= cursorState != TextDisplay_CursorState_none;
 
                 // get real row and column
                 if (realRow >= textDisplay->model->length) {
-                        cell->realRow    = textDisplay->model->length - 1;
-                        cell->realColumn = textDisplay->cells [
-                                textDisplay->lastRow * textDisplay->width +
-                                column].realColumn;
+                        cell->realRow    = lastLine;
+                        cell->realColumn = 0;
+                        if (lastLineVisible) {
+                                cell->realColumn = textDisplay->cells [
+                                        (lastLine - scroll) *
+                                        textDisplay->width +
+                                        column].realColumn;
+                        }
                 } else {
                         cell->realRow    = realRow;
                         cell->realColumn = realColumn;
@@ -138,7 +576,6 @@ static void TextDisplay_grabRow (TextDisplay *textDisplay, size_t row) {
                         if (isOwnRune) {
                                 textDisplay->lastRealColumn = realColumn;
                                 textDisplay->lastRealRow    = realRow;
-                                textDisplay->lastRow        = row;
                                 realColumn ++;
                         } else {
                                 cell->realColumn = textDisplay->lastRealColumn;
@@ -146,6 +583,8 @@ static void TextDisplay_grabRow (TextDisplay *textDisplay, size_t row) {
                         }
                 }
         }
+
+        return hasCursors;
 }
 
 /* TextDisplay_setModel
@@ -154,6 +593,7 @@ static void TextDisplay_grabRow (TextDisplay *textDisplay, size_t row) {
  */
 void TextDisplay_setModel (TextDisplay *textDisplay, EditBuffer *editBuffer) {
         textDisplay->model = editBuffer;
+        textDisplay->needsFullGrab = 1;
 }
 
 
@@ -176,7 +616,12 @@ void TextDisplay_resize (
         textDisplay->height = height;
 
         free(textDisplay->cells);
-        textDisplay->cells = calloc(width * height, sizeof(TextDisplay_Cell));
+        free(textDisplay->previousCells);
+        free(textDisplay->dirtyRows);
+        free(textDisplay->cursorRows);
+        free(textDisplay->cursorSpans.rowStarts);
+        free(textDisplay->selectionSpans.rowStarts);
+        TextDisplay_allocate(textDisplay);
 }
 
 /* TextDisplay_getRealCoords
@@ -204,4 +649,29 @@ static void TextDisplay_clear (TextDisplay *textDisplay) {
         for (size_t index = 0; index < bufferLength; index ++) {
                 textDisplay->cells[index] = (TextDisplay_Cell) { 0 };
         }
+
+        textDisplay->needsFullGrab = 1;
+        textDisplay->shiftedRows   = 0;
+}
+
+/* TextDisplay_allocate
+ * Allocates the cells and per-row data of a text display according to its
+ * width and height, filled with zero values.
+ */
+static void TextDisplay_allocate (TextDisplay *textDisplay) {
+        size_t width  = textDisplay->width;
+        size_t height = textDisplay->height;
+
+        textDisplay->cells = calloc(width * height, sizeof(TextDisplay_Cell));
+        textDisplay->previousCells =
+                calloc(width * height, sizeof(TextDisplay_Cell));
+        textDisplay->dirtyRows  = calloc(height, sizeof(uint8_t));
+        textDisplay->cursorRows = calloc(height, sizeof(uint8_t));
+
+        textDisplay->cursorSpans.rowStarts = calloc(height + 1, sizeof(size_t));
+        textDisplay->selectionSpans.rowStarts =
+                calloc(height + 1, sizeof(size_t));
+
+        textDisplay->needsFullGrab = 1;
+        textDisplay->shiftedRows   = 0;
 }
@@ -1,5 +1,24 @@
 #include "unicode.h"
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define UNICODE_X86
+#endif
+
+// how far the scalar validator goes before handing back to the vector one
+#define UNICODE_SCALAR_STRIDE 64
+
+static size_t Unicode_utf8ValidRuneSize (const uint8_t *, size_t);
+static size_t Unicode_utf8ValidateBlocks (
+        const uint8_t *, size_t, size_t, size_t *);
+
+#ifdef UNICODE_X86
+static size_t Unicode_utf8ValidateBlocksSse2 (
+        const uint8_t *, size_t, size_t, size_t *);
+static size_t Unicode_utf8ValidateBlocksAvx2 (
+        const uint8_t *, size_t, size_t, size_t *);
+#endif
+
 /* Unicode_utf8ToRune
  * Takes in a pointer to a char in the middle of a c string, and converts it,
  * possibly along with characters that came after it, into a UTF-32 rune.
@@ -86,6 +105,38 @@ Rune Unicode_utf8ArrayToRune (const uint8_t parts[4], size_t codepointSize) {
         return rune;
 }
 
+/* Unicode_runeToUtf8
+ * Encodes a rune as UTF-8 into parts, and returns the amount of bytes written.
+ * Runes outside of the unicode range are encoded as U+FFFD.
+ */
+size_t Unicode_runeToUtf8 (Rune rune, uint8_t parts[4]) {
+        if (rune > 0x10FFFF) { rune = 0xFFFD; }
+
+        if (rune < 0x80) {
+                parts[0] = (uint8_t)(rune);
+                return 1;
+        }
+        
+        if (rune < 0x800) {
+                parts[0] = (uint8_t)(UTF8_2B_CHECK | (rune >> 6));
+                parts[1] = (uint8_t)(0x80 | (rune & 0x3F));
+                return 2;
+        }
+        
+        if (rune < 0x10000) {
+                parts[0] = (uint8_t)(UTF8_3B_CHECK | (rune >> 12));
+                parts[1] = (uint8_t)(0x80 | ((rune >> 6) & 0x3F));
+                parts[2] = (uint8_t)(0x80 | (rune & 0x3F));
+                return 3;
+        }
+        
+        parts[0] = (uint8_t)(UTF8_4B_CHECK | (rune >> 18));
+        parts[1] = (uint8_t)(0x80 | ((rune >> 12) & 0x3F));
+        parts[2] = (uint8_t)(0x80 | ((rune >> 6) & 0x3F));
+        parts[3] = (uint8_t)(0x80 | (rune & 0x3F));
+        return 4;
+}
+
 /* Unicode_utf8CodepointSize
  * Returns the codepoint size of a single UTF-8 byte.
  */
@@ -97,3 +148,326 @@ size_t Unicode_utf8CodepointSize (uint8_t ch) {
 
         return 0;
 }
+
+/* Unicode_utf8Validate
+ * Checks length bytes of UTF-8 text, and returns how many bytes at the start of
+ * it are valid. The amount of runes in that valid stretch is stored in
+ * amountOfRunes. Overlong encodings, surrogates, codepoints past U+10FFFF,
+ * truncated sequences, and null bytes are all considered invalid. Long runs of
+ * text are checked many bytes at a time where the processor supports it.
+ */
+size_t Unicode_utf8Validate (
+        const char *buffer,
+        size_t     length,
+        size_t     *amountOfRunes
+) {
+        const uint8_t *bytes = (const uint8_t *)(buffer);
+        size_t index = 0;
+        size_t runes = 0;
+
+        while (index < length) {
+                index = Unicode_utf8ValidateBlocks (
+                        bytes, index, length, &runes);
+
+                // the vector validator stopped on something it couldn't
+                // handle, so go through it one codepoint at a time. this always
+                // leaves index on a codepoint boundary.
+                size_t stop = index + UNICODE_SCALAR_STRIDE;
+                while (index < length && index < stop) {
+                        size_t codepointSize = Unicode_utf8ValidRuneSize (
+                                bytes + index,
+                                length - index);
+                        if (codepointSize == 0) {
+                                *amountOfRunes = runes;
+                                return index;
+                        }
+
+                        index += codepointSize;
+                        runes ++;
+                }
+        }
+
+        *amountOfRunes = runes;
+        return index;
+}
+
+/* Unicode_utf8CountRunes
+ * Returns the amount of runes in length bytes of UTF-8 text that is already
+ * known to be valid. This is just a count of every byte that does not continue
+ * a codepoint, which the compiler can do many bytes at a time.
+ */
+size_t Unicode_utf8CountRunes (const char *buffer, size_t length) {
+        const uint8_t *bytes = (const uint8_t *)(buffer);
+
+        size_t amountOfRunes = 0;
+        for (size_t index = 0; index < length; index ++) {
+                amountOfRunes += (bytes[index] & 0xC0) != 0x80;
+        }
+        return amountOfRunes;
+}
+
+/* Unicode_utf8ValidRuneSize
+ * Returns the size of the UTF-8 codepoint at the start of bytes, or zero if it
+ * is not a complete, valid, non-null codepoint.
+ */
+static size_t Unicode_utf8ValidRuneSize (const uint8_t *bytes, size_t length) {
+        uint8_t lead = bytes[0];
+        if (lead < 0x80) { return lead != 0; }
+
+        // the second byte has a narrower range for some lead bytes, which is
+        // what rules out overlong forms, surrogates, and runes past U+10FFFF
+        size_t  codepointSize;
+        uint8_t low  = 0x80;
+        uint8_t high = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+                codepointSize = 2;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+                codepointSize = 3;
+                if (lead == 0xE0) { low  = 0xA0; }
+                if (lead == 0xED) { high = 0x9F; }
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+                codepointSize = 4;
+                if (lead == 0xF0) { low  = 0x90; }
+                if (lead == 0xF4) { high = 0x8F; }
+        } else {
+                return 0;
+        }
+
+        if (codepointSize > length)                 { return 0; }
+        if (bytes[1] < low || bytes[1] > high)      { return 0; }
+        for (size_t index = 2; index < codepointSize; index ++) {
+                if ((bytes[index] & UTF8_CONTINUE_MASK) != 0x80) { return 0; }
+        }
+
+        return codepointSize;
+}
+
+/* Unicode_utf8ValidateBlocks
+ * Validates as many whole blocks of text as possible starting at index, which
+ * must be on a codepoint boundary, using the widest vector instructions the
+ * processor has. Returns the index it stopped at, which is always on a
+ * codepoint boundary, and adds the runes it got through to amountOfRunes.
+ */
+static size_t Unicode_utf8ValidateBlocks (
+        const uint8_t *bytes,
+        size_t        index,
+        size_t        length,
+        size_t        *amountOfRunes
+) {
+#ifdef UNICODE_X86
+        static int hasAvx2 = -1;
+        if (hasAvx2 < 0) { hasAvx2 = __builtin_cpu_supports("avx2"); }
+
+        if (hasAvx2) {
+                return Unicode_utf8ValidateBlocksAvx2 (
+                        bytes, index, length, amountOfRunes);
+        }
+        return Unicode_utf8ValidateBlocksSse2 (
+                bytes, index, length, amountOfRunes);
+#else
+        (void)(bytes);
+        (void)(length);
+        (void)(amountOfRunes);
+        return index;
+#endif
+}
+
+#ifdef UNICODE_X86
+
+/* Unicode_utf8ValidateBlocksSse2
+ * Skips over 16 byte blocks of ASCII text. SSE2 has no byte shuffle to look up
+ * multibyte sequences with, so those are left to the scalar validator.
+ */
+static size_t Unicode_utf8ValidateBlocksSse2 (
+        const uint8_t *bytes,
+        size_t        index,
+        size_t        length,
+        size_t        *amountOfRunes
+) {
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; index + 16 <= length; index += 16) {
+                __m128i input = _mm_loadu_si128 (
+                        (const __m128i *)(bytes + index));
+
+                int notAscii = _mm_movemask_epi8(input);
+                int nulls    = _mm_movemask_epi8(_mm_cmpeq_epi8(input, zero));
+                if (notAscii || nulls) { break; }
+
+                *amountOfRunes += 16;
+        }
+
+        return index;
+}
+
+// error flags for the multibyte lookup tables. each pair of adjacent bytes is
+// looked up in three tables (by the high and low nibble of the first byte, and
+// the high nibble of the second) and if the three results share a flag, the
+// pair is invalid. see "Validating UTF-8 In Less Than One Instruction Per
+// Byte" by John Keiser and Daniel Lemire.
+#define UNICODE_TOO_SHORT      (1 << 0)
+#define UNICODE_TOO_LONG       (1 << 1)
+#define UNICODE_OVERLONG_3     (1 << 2)
+#define UNICODE_TOO_LARGE      (1 << 3)
+#define UNICODE_SURROGATE      (1 << 4)
+#define UNICODE_OVERLONG_2     (1 << 5)
+#define UNICODE_TOO_LARGE_1000 (1 << 6)
+#define UNICODE_OVERLONG_4     (1 << 6)
+#define UNICODE_TWO_CONTS      (1 << 7)
+#define UNICODE_CARRY \
+        (UNICODE_TOO_SHORT | UNICODE_TOO_LONG | UNICODE_TWO_CONTS)
+
+#define UNICODE_TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+/* Unicode_utf8ValidateBlocksAvx2
+ * Validates 32 byte blocks of text, including multibyte sequences that cross
+ * from one block into the next. Blocks that contain errors or null bytes are
+ * left to the scalar validator.
+ */
+__attribute__((target("avx2")))
+static size_t Unicode_utf8ValidateBlocksAvx2 (
+        const uint8_t *bytes,
+        size_t        index,
+        size_t        length,
+        size_t        *amountOfRunes
+) {
+        const __m256i byte1HighTable = UNICODE_TABLE (
+                UNICODE_TOO_LONG, UNICODE_TOO_LONG,
+                UNICODE_TOO_LONG, UNICODE_TOO_LONG,
+                UNICODE_TOO_LONG, UNICODE_TOO_LONG,
+                UNICODE_TOO_LONG, UNICODE_TOO_LONG,
+                UNICODE_TWO_CONTS, UNICODE_TWO_CONTS,
+                UNICODE_TWO_CONTS, UNICODE_TWO_CONTS,
+                UNICODE_TOO_SHORT | UNICODE_OVERLONG_2,
+                UNICODE_TOO_SHORT,
+                UNICODE_TOO_SHORT | UNICODE_OVERLONG_3 | UNICODE_SURROGATE,
+                UNICODE_TOO_SHORT | UNICODE_TOO_LARGE |
+                UNICODE_TOO_LARGE_1000 | UNICODE_OVERLONG_4);
+
+        const __m256i byte1LowTable = UNICODE_TABLE (
+                UNICODE_CARRY | UNICODE_OVERLONG_3 |
+                UNICODE_OVERLONG_2 | UNICODE_OVERLONG_4,
+                UNICODE_CARRY | UNICODE_OVERLONG_2,
+                UNICODE_CARRY,
+                UNICODE_CARRY,
+                UNICODE_CARRY | UNICODE_TOO_LARGE,
+                UNICODE_CARRY | UNICODE_TOO_LARGE | UNICODE_TOO_LARGE_1000,
+                UNICODE_CARRY | UNICODE_TOO_LARGE | UNICODE_TOO_LARGE_1000,
+                UNICODE_CARRY | UNICODE_TOO_LARGE | UNICODE_TOO_LARGE_1000,
+                UNICODE_CARRY | UNICODE_TOO_LARGE | UNICODE_TOO_LARGE_1000,
+                UNICODE_CARRY | UNICODE_TOO_LARGE | UNICODE_TOO_LARGE_1000,
+                UNICODE_CARRY | UNICODE_TOO_LARGE | UNICODE_TOO_LARGE_1000,
+                UNICODE_CARRY | UNICODE_TOO_LARGE | UNICODE_TOO_LARGE_1000,
+                UNICODE_CARRY | UNICODE_TOO_LARGE | UNICODE_TOO_LARGE_1000,
+                UNICODE_CARRY | UNICODE_TOO_LARGE | UNICODE_TOO_LARGE_1000 |
+                UNICODE_SURROGATE,
+                UNICODE_CARRY | UNICODE_TOO_LARGE | UNICODE_TOO_LARGE_1000,
+                UNICODE_CARRY | UNICODE_TOO_LARGE | UNICODE_TOO_LARGE_1000);
+
+        const __m256i byte2HighTable = UNICODE_TABLE (
+                UNICODE_TOO_SHORT, UNICODE_TOO_SHORT,
+                UNICODE_TOO_SHORT, UNICODE_TOO_SHORT,
+                UNICODE_TOO_SHORT, UNICODE_TOO_SHORT,
+                UNICODE_TOO_SHORT, UNICODE_TOO_SHORT,
+                UNICODE_TOO_LONG | UNICODE_OVERLONG_2 | UNICODE_TWO_CONTS |
+                UNICODE_OVERLONG_3 | UNICODE_TOO_LARGE_1000 |
+                UNICODE_OVERLONG_4,
+                UNICODE_TOO_LONG | UNICODE_OVERLONG_2 | UNICODE_TWO_CONTS |
+                UNICODE_OVERLONG_3 | UNICODE_TOO_LARGE,
+                UNICODE_TOO_LONG | UNICODE_OVERLONG_2 | UNICODE_TWO_CONTS |
+                UNICODE_SURROGATE | UNICODE_TOO_LARGE,
+                UNICODE_TOO_LONG | UNICODE_OVERLONG_2 | UNICODE_TWO_CONTS |
+                UNICODE_SURROGATE | UNICODE_TOO_LARGE,
+                UNICODE_TOO_SHORT, UNICODE_TOO_SHORT,
+                UNICODE_TOO_SHORT, UNICODE_TOO_SHORT);
+
+        const __m256i zero        = _mm256_setzero_si256();
+        const __m256i nibble      = _mm256_set1_epi8(0x0F);
+        const __m256i high        = _mm256_set1_epi8((char)(0x80));
+        const __m256i thirdMin    = _mm256_set1_epi8((char)(0xE0 - 0x80));
+        const __m256i fourthMin   = _mm256_set1_epi8((char)(0xF0 - 0x80));
+        const __m256i continueMax = _mm256_set1_epi8((char)(0xBF));
+
+        // anything bigger than these in the last three bytes of a block
+        // starts a codepoint that continues into the next one
+        const __m256i incompleteMax = _mm256_setr_epi8 (
+                -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, -1, -1, -1,
+                -1, -1, -1, -1, -1, (char)(0xF0 - 1),
+                (char)(0xE0 - 1), (char)(0xC0 - 1));
+
+        // since index is on a codepoint boundary, the bytes before it can be
+        // treated as nulls without changing the result
+        __m256i previous   = zero;
+        int     incomplete = 0;
+
+        for (; index + 32 <= length; index += 32) {
+                __m256i input = _mm256_loadu_si256 (
+                        (const __m256i *)(bytes + index));
+
+                __m256i nulls = _mm256_cmpeq_epi8(input, zero);
+                if (!_mm256_testz_si256(nulls, nulls)) { break; }
+
+                if (_mm256_movemask_epi8(input) == 0 && !incomplete) {
+                        *amountOfRunes += 32;
+                        previous = input;
+                        continue;
+                }
+
+                // line up each byte with the three that came before it
+                __m256i carried = _mm256_permute2x128_si256 (
+                        previous, input, 0x21);
+                __m256i previous1 = _mm256_alignr_epi8(input, carried, 15);
+                __m256i previous2 = _mm256_alignr_epi8(input, carried, 14);
+                __m256i previous3 = _mm256_alignr_epi8(input, carried, 13);
+
+                __m256i byte1High = _mm256_shuffle_epi8 (
+                        byte1HighTable,
+                        _mm256_and_si256 (
+                                _mm256_srli_epi16(previous1, 4), nibble));
+                __m256i byte1Low = _mm256_shuffle_epi8 (
+                        byte1LowTable,
+                        _mm256_and_si256(previous1, nibble));
+                __m256i byte2High = _mm256_shuffle_epi8 (
+                        byte2HighTable,
+                        _mm256_and_si256 (
+                                _mm256_srli_epi16(input, 4), nibble));
+                __m256i specialCases = _mm256_and_si256 (
+                        _mm256_and_si256(byte1High, byte1Low), byte2High);
+
+                // the third and fourth bytes of a codepoint must be
+                // continuations, and nothing else may be. the tables flag
+                // every continuation byte as TWO_CONTS, so this cancels it out
+                // where it was expected.
+                __m256i mustContinue = _mm256_and_si256 (
+                        _mm256_or_si256 (
+                                _mm256_subs_epu8(previous2, thirdMin),
+                                _mm256_subs_epu8(previous3, fourthMin)),
+                        high);
+                __m256i error = _mm256_xor_si256(mustContinue, specialCases);
+
+                if (!_mm256_testz_si256(error, error)) { break; }
+
+                // every byte that isn't a continuation starts a rune. as
+                // signed numbers, continuations are the ones at or below -65.
+                __m256i starts = _mm256_cmpgt_epi8(input, continueMax);
+                *amountOfRunes += (size_t)(__builtin_popcount (
+                        (unsigned int)(_mm256_movemask_epi8(starts))));
+
+                __m256i unfinished = _mm256_subs_epu8(input, incompleteMax);
+                incomplete = !_mm256_testz_si256(unfinished, unfinished);
+                previous   = input;
+        }
+
+        // if the last block we got through ended partway through a codepoint,
+        // back up to where it starts so the scalar validator can check it
+        if (incomplete) {
+                do { index --; } while ((bytes[index] & 0xC0) == 0x80);
+                *amountOfRunes -= 1;
+        }
+
+        return index;
+}
+
+#endif
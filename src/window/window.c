@@ -4,23 +4,62 @@
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
+#include <X11/extensions/XShm.h>
 
 #include <cairo.h>
 #include <cairo-xlib.h>
 
+#include <time.h>
 #include <stdio.h>
-#include <sys/time.h>
-#include <sys/select.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/shm.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include "window.h"
 
+// the most events that are taken from epoll in one go
+#define WINDOW_MAX_EVENTS 16
+
+// the order the bytes of a CAIRO_FORMAT_RGB24 pixel are in on this machine
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define WINDOW_BYTE_ORDER LSBFirst
+#else
+#define WINDOW_BYTE_ORDER MSBFirst
+#endif
+
 typedef unsigned long long Timestamp;
 
-cairo_surface_t *Window_surface  = { 0 };
-cairo_t         *Window_context  = { 0 };
-time_t           Window_interval = 0;
+/* Window_File
+ * A file descriptor that the event loop waits on along with the X connection.
+ * The callback is called whenever it can be read from.
+ */
+typedef struct {
+        int  fileDescriptor;
+        void (*callback) (int);
+} Window_File;
 
-static Timestamp previousTimestamp = 0;
+/* Window_Timer
+ * A timer in the timer heap. It fires once the deadline has passed, and if it
+ * has a period, it is then put back in to fire again that much later.
+ */
+typedef struct {
+        Timestamp deadline;
+        time_t    period;
+        size_t    id;
+        void    (*callback) (void *);
+        void     *data;
+} Window_Timer;
+
+cairo_surface_t *Window_surface       = { 0 };
+cairo_t         *Window_context       = { 0 };
+time_t           Window_interval      = 0;
+time_t           Window_frameInterval = 0;
+int              Window_sharedMemory  = 0;
+
+static Timestamp previousFrame     = 0;
 
 static int width  = 640;
 static int height = 480;
@@ -33,21 +72,70 @@ static int      screen  = { 0 };
 
 static Atom windowDeleteEvent;
 
+static cairo_surface_t *backBuffer     = { 0 };
+static cairo_t         *presentContext = { 0 };
+static cairo_region_t  *damage         = { 0 };
+
 static struct {
-        void (*onRedraw)      (int, int, int);
-        void (*onMouseButton) (int, Window_MouseButton, Window_State);
-        void (*onMouseMove)   (int, int, int);
-        void (*onInterval)    (int);
-        void (*onKey)         (int, Window_KeySym, Rune, Window_State);
+        XShmSegmentInfo segment;
+        XImage         *image;
+        int             completionType;
+        size_t          pending;
+        int             failed;
+} shared = { 0 };
+
+static int epollFile = -1;
+static int wakeFile  = -1;
+
+static size_t intervalTimer = 0;
+static size_t frameTimer    = 0;
+
+static struct {
+        void (*onRedraw)      (int, int);
+        void (*onMouseButton) (Window_MouseButton, Window_State);
+        void (*onMouseMove)   (int, int);
+        void (*onInterval)    (void);
+        void (*onKey)         (Window_KeySym, Rune, Window_State);
+        void (*onWake)        (void);
+        void (*onFrame)       (void);
 } callbacks = { 0 };
 
-static Error respondToEvent       (int, XEvent);
-static Error respondToEventButton (int, unsigned int, Window_State);
-static Error respondToEventKey    (int, XKeyEvent *, Window_State);
+static struct {
+        Window_File *list;
+        size_t       amount;
+        size_t       size;
+} files = { 0 };
+
+static struct {
+        Window_Timer *list;
+        size_t        amount;
+        size_t        size;
+        size_t        nextId;
+} timers = { 0 };
+
+static Error respondToEvent       (XEvent);
+static Error respondToEventButton (unsigned int, Window_State);
+static Error respondToEventKey    (XKeyEvent *, Window_State);
+static void  respondToFile        (int);
+static void  respondToWake        (void);
+static void  respondToTimers      (void);
+static void  respondToInterval    (void *);
+static void  respondToFrame       (void *);
+
+static void      resizeBackBuffer (void);
+static void      present          (void);
+
+static int  createSharedBackBuffer (void);
+static void freeSharedBackBuffer   (void);
+static void waitForSharedPresent   (void);
+static Bool isSharedCompletion     (Display *, XEvent *, XPointer);
+static int  catchSharedError       (Display *, XErrorEvent *);
 
-static int       fileDescriptorTimeout (int, time_t);
-static int       nextXEventOrTimeout   (XEvent *, time_t);
-static Timestamp currentTimestamp      (void);
+static int       nextTimeout      (void);
+static void      removeTimerAt    (size_t);
+static void      siftTimerUp      (size_t);
+static void      siftTimerDown    (size_t);
+static Timestamp currentTimestamp (void);
 
 /* Window_start
  * Opens the window and sets up the cairo rendering context. THe window will
@@ -82,7 +170,30 @@ Error Window_start () {
                 Window_surface,
                 width, height);
 
-        Window_context = cairo_create(Window_surface);
+        // everything is drawn into a back buffer that is kept around
+        // between frames, and only the parts of it that were drawn over are
+        // copied onto the window
+        presentContext = cairo_create(Window_surface);
+        damage         = cairo_region_create();
+        resizeBackBuffer();
+
+        // the event loop waits on the X connection, any files added with
+        // Window_addFile, and an eventfd that other threads can wake it up
+        // with
+        epollFile = epoll_create1(EPOLL_CLOEXEC);
+        wakeFile  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (epollFile < 0 || wakeFile < 0) { return Error_cantWatchFile; }
+
+        int xFileDescriptor = ConnectionNumber(display);
+        struct epoll_event event = { .events = EPOLLIN };
+        event.data.fd = xFileDescriptor;
+        if (epoll_ctl(epollFile, EPOLL_CTL_ADD, xFileDescriptor, &event)) {
+                return Error_cantWatchFile;
+        }
+        event.data.fd = wakeFile;
+        if (epoll_ctl(epollFile, EPOLL_CTL_ADD, wakeFile, &event)) {
+                return Error_cantWatchFile;
+        }
 
         started = 1;
         return Error_none;
@@ -102,51 +213,78 @@ Error Window_show (void) {
 /* Window_listen
  * Blocking event loop. This function will return when the application exits,
  * from within an event handler or in response to a close request from the
- * window manager.
+ * window manager. Between events, it sleeps in epoll until the X connection or
+ * any added file can be read from, the loop is woken up with Window_wake, or
+ * the next timer is due. Event handlers don't draw anything themselves; they
+ * ask for a frame with Window_requestFrame, and the frame callback is called at
+ * most once every Window_frameInterval milliseconds.
  */
 Error Window_listen (void) {
         listening = 1;
+        if (callbacks.onInterval != NULL && Window_interval > 0) {
+                intervalTimer = Window_addTimer (
+                        Window_interval, Window_interval,
+                        respondToInterval, NULL);
+        }
+
+        int xFileDescriptor = ConnectionNumber(display);
         while (listening) {
-                XEvent event;
-                int timedOut = nextXEventOrTimeout(&event, Window_interval);
-                int render   = XEventsQueued(display, QueuedAfterFlush) < 2;
+                // xlib might have already read in events that haven't been
+                // handled yet, and those won't wake epoll up
+                int timeout = nextTimeout();
+                if (XPending(display)) { timeout = 0; }
 
-                cairo_push_group(Window_context);
+                struct epoll_event events[WINDOW_MAX_EVENTS];
+                int amountOfEvents = epoll_wait (
+                        epollFile,
+                        events, WINDOW_MAX_EVENTS,
+                        timeout);
+                if (amountOfEvents < 0) { amountOfEvents = 0; }
 
-                if (!timedOut) {
-                        Error err = respondToEvent(render, event);
+                // every event that has come in is handled before anything is
+                // drawn, so that a burst of them, like a held down key or a
+                // drag, only ends up drawing one frame
+                while (listening && XPending(display)) {
+                        XEvent event;
+                        XNextEvent(display, &event);
+                        Error err = respondToEvent(event);
                         if (err) { return err; }
                 }
+                if (!listening) { break; }
 
-                Timestamp newTimestamp = currentTimestamp();
-                Timestamp maxTimestamp =
-                        previousTimestamp +
-                        (Timestamp)(Window_interval);
-                if (timedOut || newTimestamp > maxTimestamp) {
-                        previousTimestamp = newTimestamp;
-                        if (callbacks.onInterval != NULL) {
-                                callbacks.onInterval(1);
+                for (int index = 0; index < amountOfEvents; index ++) {
+                        int fileDescriptor = events[index].data.fd;
+                        if (fileDescriptor == xFileDescriptor) {
+                                continue;
+                        } else if (fileDescriptor == wakeFile) {
+                                respondToWake();
+                        } else {
+                                respondToFile(fileDescriptor);
                         }
                 }
 
-                cairo_pop_group_to_source(Window_context);
-                cairo_paint(Window_context);        
-                cairo_surface_flush(Window_surface);
+                respondToTimers();
         }
 
+        Window_removeTimer(intervalTimer);
+        intervalTimer = 0;
         return Error_none;
 }
 
 /* respondToEvent
  * Handle a single event from the Xlib event loop in Window_listen.
  */
-static Error respondToEvent (int render, XEvent event) {
+static Error respondToEvent (XEvent event) {
         Error err;
+
+        if (shared.image != NULL && event.type == shared.completionType) {
+                if (shared.pending > 0) { shared.pending --; }
+                return Error_none;
+        }
         
         switch (event.type) {
         case ButtonPress:
                 err = respondToEventButton (
-                        render,
                         event.xbutton.button,
                         Window_State_on);
                 if (err) { return err; }
@@ -154,44 +292,38 @@ static Error respondToEvent (int render, XEvent event) {
         
         case ButtonRelease:
                 err = respondToEventButton (
-                        render,
                         event.xbutton.button,
                         Window_State_off);
                 if (err) { return err; }
                 break;
 
         case KeyPress:
-                err = respondToEventKey(render, &event.xkey, Window_State_on);
+                err = respondToEventKey(&event.xkey, Window_State_on);
                 if (err) { return err; }
                 break;
         
         case KeyRelease:
-                err = respondToEventKey(render, &event.xkey, Window_State_off);
+                err = respondToEventKey(&event.xkey, Window_State_off);
                 if (err) { return err; }
                 break;
 
-        case MotionNotify: ;
-                int mouseX;
-                int mouseY;
-                // seriously xlib? i just want the mose position.
-                int          garbageI;
-                unsigned int garbageU;
-                Window       garbageW;
-                XQueryPointer (
-                        display, window,
-                        &garbageW, &garbageW, &garbageI, &garbageI,
-                        &mouseX, &mouseY,
-                        &garbageU);
-                        
+        case MotionNotify:
+                // only where the mouse ended up matters, so a run of motion
+                // events waiting in the queue is collapsed into the last one
+                while (XEventsQueued(display, QueuedAlready) > 0) {
+                        XEvent next;
+                        XPeekEvent(display, &next);
+                        if (next.type != MotionNotify) { break; }
+                        XNextEvent(display, &event);
+                }
+
                 if (callbacks.onMouseMove == NULL) { break; }
-                callbacks.onMouseMove(render, mouseX, mouseY);
+                callbacks.onMouseMove(event.xmotion.x, event.xmotion.y);
                 break;
 
         case Expose:
                 if (callbacks.onRedraw == NULL) { break; }
-
-                cairo_paint(Window_context);
-                callbacks.onRedraw(render, width, height);
+                callbacks.onRedraw(width, height);
                 break;
 
         case ConfigureNotify: ;
@@ -205,6 +337,12 @@ static Error respondToEvent (int render, XEvent event) {
                 cairo_xlib_surface_set_size (
                         Window_surface,
                         width, height);
+
+                // the new back buffer starts out empty, so everything has to
+                // be drawn again even if no part of the window was exposed
+                resizeBackBuffer();
+                if (callbacks.onRedraw == NULL) { break; }
+                callbacks.onRedraw(width, height);
                 break;
         
         case ClientMessage:
@@ -219,7 +357,6 @@ static Error respondToEvent (int render, XEvent event) {
  * Respond to a single mouse button event.
  */
 static Error respondToEventButton (
-        int          render, 
         unsigned int button,
         Window_State state
 ) {
@@ -228,31 +365,26 @@ static Error respondToEventButton (
         switch (button) {
         case 1:
                 callbacks.onMouseButton (
-                        render,
                         Window_MouseButton_left,
                         state);
                 break;
         case 2:
                 callbacks.onMouseButton (
-                        render,
                         Window_MouseButton_middle,
                         state);
                 break;
         case 3:
                 callbacks.onMouseButton (
-                        render,
                         Window_MouseButton_right,
                         state);
                 break;
         case 4:
                 callbacks.onMouseButton (
-                        render,
                         Window_MouseButton_scrollUp,
                         state);
                 break;
         case 5:
                 callbacks.onMouseButton (
-                        render,
                         Window_MouseButton_scrollDown,
                         state);
                 break;
@@ -262,7 +394,6 @@ static Error respondToEventButton (
 }
 
 static Error respondToEventKey (
-        int          render,
         XKeyEvent   *event,
         Window_State state
 ) {
@@ -274,55 +405,404 @@ static Error respondToEventKey (
                 0, event->state & ShiftMask ? 1 : 0);
         
         Rune rune = (Rune)(xkb_keysym_to_utf32((xkb_keysym_t)(keySym)));
-        callbacks.onKey(render, keySym, rune, state);
+        callbacks.onKey(keySym, rune, state);
 
         return Error_none;
 }
 
-/* fileDescriptorTimeout
- * Waits for an event on fileDescriptor, for the max amount of time specified by
- * milliseconds. Returns 1 if the timeout was reached.
+/* respondToFile
+ * Calls the callback of a file that was added with Window_addFile, if it hasn't
+ * been removed since epoll said it could be read from.
  */
-static int fileDescriptorTimeout (int fileDescriptor, time_t milliseconds) {
-        fd_set fileDescriptorSet;
-        FD_ZERO(&fileDescriptorSet);
-        FD_SET(fileDescriptor, &fileDescriptorSet);
-        
-        struct timeval time = { 0 };
-        time.tv_usec = milliseconds * 1000;
-        
-        return select(fileDescriptor + 1, &fileDescriptorSet, 0, 0, &time);
+static void respondToFile (int fileDescriptor) {
+        for (size_t index = 0; index < files.amount; index ++) {
+                Window_File *file = &files.list[index];
+                if (file->fileDescriptor != fileDescriptor) { continue; }
+
+                file->callback(fileDescriptor);
+                return;
+        }
 }
 
-/* nextXEventOrTimeout
- * Gets the next X event, but only waits for the maximum amount of time
- * specified by milliseconds. If milliseconds is zero, there will be no timeout.
- * Returns 1 if the timeout was reached, and zero if an event was recieved.
+/* respondToWake
+ * Resets the eventfd after the event loop was woken up with Window_wake, and
+ * lets the wake callback know. No matter how many times the loop was woken up
+ * since last time, the callback is only called once.
  */
-static int nextXEventOrTimeout (XEvent *event, time_t milliseconds) {
-        int xFileDescriptor = ConnectionNumber(display);
+static void respondToWake (void) {
+        uint64_t amount;
+        ssize_t  amountRead = read(wakeFile, &amount, sizeof(amount));
+        if (amountRead != sizeof(amount)) { return; }
+
+        if (callbacks.onWake == NULL) { return; }
+        callbacks.onWake();
+}
+
+/* respondToTimers
+ * Fires every timer whose deadline has passed, soonest first. Timers with a
+ * period are put back into the heap to fire again. If a timer fell more than a
+ * whole period behind, it skips ahead instead of firing over and over again to
+ * catch up.
+ */
+static void respondToTimers (void) {
+        Timestamp now = currentTimestamp();
+
+        while (timers.amount > 0 && timers.list[0].deadline <= now) {
+                Window_Timer timer = timers.list[0];
+
+                if (timer.period > 0) {
+                        Timestamp period = (Timestamp)(timer.period);
+                        Window_Timer *next = &timers.list[0];
+                        next->deadline += period;
+                        if (next->deadline <= now) {
+                                next->deadline = now + period;
+                        }
+                        siftTimerDown(0);
+                } else {
+                        removeTimerAt(0);
+                }
+
+                timer.callback(timer.data);
+        }
+}
+
+/* respondToInterval
+ * The timer callback for Window_interval.
+ */
+static void respondToInterval (void *data) {
+        (void)(data);
+        if (callbacks.onInterval == NULL) { return; }
+        callbacks.onInterval();
+}
+
+/* respondToFrame
+ * The timer callback for frames asked for with Window_requestFrame. Whatever
+ * the frame callback draws goes into the back buffer, and then the damaged
+ * parts of it are shown all at once.
+ */
+static void respondToFrame (void *data) {
+        (void)(data);
+        frameTimer    = 0;
+        previousFrame = currentTimestamp();
+        if (callbacks.onFrame == NULL) { return; }
+
+        // the server might still be reading the last frame out of shared
+        // memory, and it can't be drawn over until it is done
+        waitForSharedPresent();
+        callbacks.onFrame();
+        present();
+}
+
+/* resizeBackBuffer
+ * Makes a new back buffer the size of the window, and points Window_context at
+ * it. If Window_sharedMemory is set and the server allows it, the back buffer
+ * is an image in memory shared with the server, and is drawn into without
+ * going through the X connection at all. Otherwise, it is a pixmap on the
+ * server. The font of the old context is carried over, but whatever was drawn
+ * in the old back buffer is thrown away.
+ */
+static void resizeBackBuffer (void) {
+        cairo_matrix_t     fontMatrix;
+        cairo_font_face_t *fontFace = NULL;
+
+        if (Window_context != NULL) {
+                cairo_get_font_matrix(Window_context, &fontMatrix);
+                fontFace = cairo_font_face_reference (
+                        cairo_get_font_face(Window_context));
+
+                cairo_destroy(Window_context);
+                cairo_surface_destroy(backBuffer);
+                freeSharedBackBuffer();
+        }
+
+        if (!Window_sharedMemory || !createSharedBackBuffer()) {
+                backBuffer = cairo_surface_create_similar (
+                        Window_surface,
+                        CAIRO_CONTENT_COLOR,
+                        width, height);
+        }
+        Window_context = cairo_create(backBuffer);
+
+        if (fontFace != NULL) {
+                cairo_set_font_matrix(Window_context, &fontMatrix);
+                cairo_set_font_face(Window_context, fontFace);
+                cairo_font_face_destroy(fontFace);
+        }
+}
+
+/* present
+ * Copies every part of the back buffer that was damaged since the last time
+ * onto the window.
+ */
+static void present (void) {
+        // lines along the edge of the window damage a bit past it
+        cairo_rectangle_int_t bounds = { 0, 0, width, height };
+        cairo_region_intersect_rectangle(damage, &bounds);
+
+        int amount = cairo_region_num_rectangles(damage);
+        if (amount == 0) { return; }
+
+        if (shared.image != NULL) {
+                cairo_surface_flush(backBuffer);
+        } else {
+                cairo_set_operator(presentContext, CAIRO_OPERATOR_SOURCE);
+                cairo_set_source_surface(presentContext, backBuffer, 0, 0);
+        }
+
+        for (int index = 0; index < amount; index ++) {
+                cairo_rectangle_int_t rectangle;
+                cairo_region_get_rectangle(damage, index, &rectangle);
+
+                if (shared.image == NULL) {
+                        cairo_rectangle (
+                                presentContext,
+                                rectangle.x,     rectangle.y,
+                                rectangle.width, rectangle.height);
+                        continue;
+                }
+
+                // only the last one needs to say when it is done, since the
+                // server handles them in order
+                int last = index == amount - 1;
+                XShmPutImage (
+                        display, window, DefaultGC(display, screen),
+                        shared.image,
+                        rectangle.x, rectangle.y,
+                        rectangle.x, rectangle.y,
+                        (unsigned)(rectangle.width),
+                        (unsigned)(rectangle.height),
+                        last ? True : False);
+                if (last) { shared.pending ++; }
+        }
+
+        if (shared.image == NULL) {
+                cairo_fill(presentContext);
+                cairo_surface_flush(Window_surface);
+        } else {
+                XFlush(display);
+        }
+
+        cairo_region_destroy(damage);
+        damage = cairo_region_create();
+}
+
+/* createSharedBackBuffer
+ * Tries to make the back buffer an image in a MIT-SHM segment. This only works
+ * if the server is on the same machine, and if its pixels are laid out the same
+ * way as CAIRO_FORMAT_RGB24, so that cairo can draw right into it. Returns 1 if
+ * it worked, and 0 if the back buffer has to be made some other way.
+ */
+static int createSharedBackBuffer (void) {
+        if (!XShmQueryExtension(display)) { return 0; }
+
+        XImage *image = XShmCreateImage (
+                display,
+                DefaultVisual(display, screen),
+                (unsigned)(DefaultDepth(display, screen)),
+                ZPixmap, NULL, &shared.segment,
+                (unsigned)(width), (unsigned)(height));
+        if (image == NULL) { return 0; }
 
         if (
-                milliseconds == 0 ||
-                XPending(display) ||
-                fileDescriptorTimeout(xFileDescriptor, milliseconds)
+                image->bits_per_pixel != 32       ||
+                image->red_mask       != 0xFF0000 ||
+                image->green_mask     != 0xFF00   ||
+                image->blue_mask      != 0xFF     ||
+                image->byte_order     != WINDOW_BYTE_ORDER
         ) {
-                XNextEvent(display, event);
+                XDestroyImage(image);
+                return 0;
+        }
+
+        shared.segment.shmid = shmget (
+                IPC_PRIVATE,
+                (size_t)(image->bytes_per_line) * (size_t)(image->height),
+                IPC_CREAT | 0600);
+        if (shared.segment.shmid < 0) {
+                XDestroyImage(image);
                 return 0;
-        } else {
-                return 1;
+        }
+
+        shared.segment.shmaddr  = shmat(shared.segment.shmid, NULL, 0);
+        shared.segment.readOnly = False;
+        if (shared.segment.shmaddr == (char *)(-1)) {
+                shmctl(shared.segment.shmid, IPC_RMID, NULL);
+                XDestroyImage(image);
+                return 0;
+        }
+        image->data = shared.segment.shmaddr;
+
+        // a server on another machine can still say it has the extension,
+        // and then fail to attach. that error comes back later on, so it is
+        // waited for and caught here instead of taking the whole program down.
+        shared.failed = 0;
+        int (*previousHandler) (Display *, XErrorEvent *) =
+                XSetErrorHandler(catchSharedError);
+        XShmAttach(display, &shared.segment);
+        XSync(display, False);
+        XSetErrorHandler(previousHandler);
+
+        // the segment goes away once both sides have let go of it, even if
+        // this crashes
+        shmctl(shared.segment.shmid, IPC_RMID, NULL);
+
+        if (shared.failed) {
+                shmdt(shared.segment.shmaddr);
+                image->data = NULL;
+                XDestroyImage(image);
+                return 0;
+        }
+
+        shared.image          = image;
+        shared.pending        = 0;
+        shared.completionType = XShmGetEventBase(display) + ShmCompletion;
+        backBuffer = cairo_image_surface_create_for_data (
+                (unsigned char *)(image->data),
+                CAIRO_FORMAT_RGB24,
+                width, height,
+                image->bytes_per_line);
+        return 1;
+}
+
+/* freeSharedBackBuffer
+ * Lets go of the shared memory back buffer, if there is one. Its cairo surface
+ * has to already be destroyed.
+ */
+static void freeSharedBackBuffer (void) {
+        if (shared.image == NULL) { return; }
+
+        waitForSharedPresent();
+        XShmDetach(display, &shared.segment);
+        XSync(display, False);
+        shmdt(shared.segment.shmaddr);
+
+        shared.image->data = NULL;
+        XDestroyImage(shared.image);
+        shared.image = NULL;
+}
+
+/* waitForSharedPresent
+ * Waits until the server is done copying frames out of the shared memory back
+ * buffer. Usually it already is by the time the next frame is drawn, so this
+ * doesn't wait at all.
+ */
+static void waitForSharedPresent (void) {
+        while (shared.image != NULL && shared.pending > 0) {
+                XEvent event;
+                XIfEvent(display, &event, isSharedCompletion, NULL);
+                shared.pending --;
+        }
+}
+
+/* isSharedCompletion
+ * The predicate for XIfEvent in waitForSharedPresent.
+ */
+static Bool isSharedCompletion (
+        Display *eventDisplay,
+        XEvent  *event,
+        XPointer argument
+) {
+        (void)(eventDisplay);
+        (void)(argument);
+        return event->type == shared.completionType;
+}
+
+/* catchSharedError
+ * The X error handler used while attaching the shared memory back buffer.
+ */
+static int catchSharedError (Display *errorDisplay, XErrorEvent *error) {
+        (void)(errorDisplay);
+        (void)(error);
+        shared.failed = 1;
+        return 0;
+}
+
+/* nextTimeout
+ * Returns how many milliseconds epoll should wait for until the next timer is
+ * due, or -1 if there are no timers and it should wait forever.
+ */
+static int nextTimeout (void) {
+        if (timers.amount == 0) { return -1; }
+
+        Timestamp now      = currentTimestamp();
+        Timestamp deadline = timers.list[0].deadline;
+        if (deadline <= now)             { return 0; }
+        if (deadline - now >= INT32_MAX) { return INT32_MAX; }
+        return (int)(deadline - now);
+}
+
+/* removeTimerAt
+ * Removes the timer at index from the timer heap.
+ */
+static void removeTimerAt (size_t index) {
+        timers.amount --;
+        if (index == timers.amount) { return; }
+
+        timers.list[index] = timers.list[timers.amount];
+        siftTimerUp(index);
+        siftTimerDown(index);
+}
+
+/* siftTimerUp
+ * Moves the timer at index up the timer heap until it is due no sooner than the
+ * timer above it.
+ */
+static void siftTimerUp (size_t index) {
+        while (index > 0) {
+                size_t    parent   = (index - 1) / 2;
+                Timestamp deadline = timers.list[index].deadline;
+                if (timers.list[parent].deadline <= deadline) { return; }
+
+                Window_Timer timer  = timers.list[parent];
+                timers.list[parent] = timers.list[index];
+                timers.list[index]  = timer;
+                index = parent;
+        }
+}
+
+/* siftTimerDown
+ * Moves the timer at index down the timer heap until it is due no later than
+ * the timers below it.
+ */
+static void siftTimerDown (size_t index) {
+        for (;;) {
+                size_t soonest = index;
+                size_t left    = index * 2 + 1;
+                size_t right   = index * 2 + 2;
+
+                if (
+                        left < timers.amount &&
+                        timers.list[left].deadline <
+                                timers.list[soonest].deadline
+                ) {
+                        soonest = left;
+                }
+                if (
+                        right < timers.amount &&
+                        timers.list[right].deadline <
+                                timers.list[soonest].deadline
+                ) {
+                        soonest = right;
+                }
+                if (soonest == index) { return; }
+
+                Window_Timer timer   = timers.list[soonest];
+                timers.list[soonest] = timers.list[index];
+                timers.list[index]   = timer;
+                index = soonest;
         }
 }
 
 /* currentTimestamp
- * Returns the current UNIX timestamp in milliseconds.
+ * Returns the current time in milliseconds. The time is taken from a monotonic
+ * clock, so timers aren't thrown off when the system clock is changed.
  */
 static Timestamp currentTimestamp () {
-        struct timeval time; 
-        gettimeofday(&time, NULL);
+        struct timespec time;
+        clock_gettime(CLOCK_MONOTONIC, &time);
         Timestamp milliseconds =
                 (Timestamp) (time.tv_sec  * 1000) +
-                (Timestamp) (time.tv_usec / 1000);
+                (Timestamp) (time.tv_nsec / 1000000);
         return milliseconds;
 }
 
@@ -336,13 +816,261 @@ Error Window_stop (void) {
         listening = 0;
         started   = 0;
 
+        cairo_destroy(Window_context);
+        cairo_destroy(presentContext);
+        cairo_surface_destroy(backBuffer);
         cairo_surface_destroy(Window_surface);
+        freeSharedBackBuffer();
+        cairo_region_destroy(damage);
+        Window_context = NULL;
+        presentContext = NULL;
+        backBuffer     = NULL;
+        damage         = NULL;
+
+        close(epollFile);
+        close(wakeFile);
+        epollFile = -1;
+        wakeFile  = -1;
+        free(files.list);
+        free(timers.list);
+        files.list    = NULL;
+        files.amount  = 0;
+        files.size    = 0;
+        timers.list   = NULL;
+        timers.amount = 0;
+        timers.size   = 0;
+        frameTimer    = 0;
+
         int status = XCloseDisplay(display);
         if (status != 1) { return Error_cantCloseDisplay; }
 
         return Error_none;
 }
 
+/* Window_addFile
+ * Makes the event loop wait on fileDescriptor as well. Whenever it can be read
+ * from, callback is called with it. Whatever is waiting to be read has to be
+ * read by the callback, or else it will just be called again right away. This
+ * only works once the window has been started.
+ */
+Error Window_addFile (
+        int fileDescriptor,
+        void (*callback) (int fileDescriptor)
+) {
+        if (epollFile < 0) { return Error_cantWatchFile; }
+
+        struct epoll_event event = { .events = EPOLLIN };
+        event.data.fd = fileDescriptor;
+        if (epoll_ctl(epollFile, EPOLL_CTL_ADD, fileDescriptor, &event)) {
+                return Error_cantWatchFile;
+        }
+
+        if (files.amount == files.size) {
+                files.size = files.size * 2 + 4;
+                files.list = realloc (
+                        files.list,
+                        files.size * sizeof(Window_File));
+        }
+        files.list[files.amount ++] = (Window_File) {
+                .fileDescriptor = fileDescriptor,
+                .callback       = callback,
+        };
+        return Error_none;
+}
+
+/* Window_removeFile
+ * Stops the event loop from waiting on fileDescriptor. This must be called
+ * before the file descriptor is closed, since another one could be opened with
+ * the same number.
+ */
+void Window_removeFile (int fileDescriptor) {
+        for (size_t index = 0; index < files.amount; index ++) {
+                if (files.list[index].fileDescriptor != fileDescriptor) {
+                        continue;
+                }
+
+                epoll_ctl(epollFile, EPOLL_CTL_DEL, fileDescriptor, NULL);
+                files.list[index] = files.list[-- files.amount];
+                return;
+        }
+}
+
+/* Window_addTimer
+ * Adds a timer that calls callback with data once delay milliseconds have
+ * passed. If period is more than zero, it keeps on firing every period
+ * milliseconds after that. Returns the id of the timer, which is never zero.
+ */
+size_t Window_addTimer (
+        time_t delay,
+        time_t period,
+        void (*callback) (void *data),
+        void *data
+) {
+        if (timers.amount == timers.size) {
+                timers.size = timers.size * 2 + 8;
+                timers.list = realloc (
+                        timers.list,
+                        timers.size * sizeof(Window_Timer));
+        }
+
+        size_t id = ++ timers.nextId;
+        timers.list[timers.amount] = (Window_Timer) {
+                .deadline = currentTimestamp() + (Timestamp)(delay),
+                .period   = period,
+                .id       = id,
+                .callback = callback,
+                .data     = data,
+        };
+        siftTimerUp(timers.amount ++);
+        return id;
+}
+
+/* Window_removeTimer
+ * Removes a timer, so that it won't fire anymore. Nothing happens if there is
+ * no timer with the given id, or if it already fired and didn't repeat.
+ */
+void Window_removeTimer (size_t id) {
+        for (size_t index = 0; index < timers.amount; index ++) {
+                if (timers.list[index].id != id) { continue; }
+                removeTimerAt(index);
+                return;
+        }
+}
+
+/* Window_wake
+ * Wakes the event loop up, and has it call the wake callback. Unlike anything
+ * else in this module, this can be called from any thread, so that work done
+ * in the background can let the main thread know it is done.
+ */
+void Window_wake (void) {
+        uint64_t amount  = 1;
+        ssize_t  written = write(wakeFile, &amount, sizeof(amount));
+        (void)(written);
+}
+
+/* Window_requestFrame
+ * Has the frame callback called once the next frame is due, which is right
+ * away if the last one was at least Window_frameInterval milliseconds ago.
+ * Asking for a frame again before then does nothing, so however many times
+ * this is called, the frame callback is only called once.
+ */
+void Window_requestFrame (void) {
+        if (frameTimer != 0) { return; }
+
+        Timestamp now  = currentTimestamp();
+        Timestamp due  = previousFrame + (Timestamp)(Window_frameInterval);
+        time_t    wait = 0;
+        if (due > now) { wait = (time_t)(due - now); }
+
+        frameTimer = Window_addTimer(wait, 0, respondToFrame, NULL);
+}
+
+/* Window_damage
+ * Marks a rectangle of Window_context as drawn over, so that it is copied onto
+ * the window in the next frame. The rectangle is rounded out to whole pixels,
+ * with one more on each side for lines drawn along its edges. Damaging more
+ * than was drawn is harmless, since the back buffer always holds the whole
+ * window as it should look.
+ */
+void Window_damage (double x, double y, double width, double height) {
+        if (damage == NULL) { return; }
+
+        int left   = (int)(x) - 1;
+        int top    = (int)(y) - 1;
+        int right  = (int)(x + width)  + 2;
+        int bottom = (int)(y + height) + 2;
+
+        cairo_rectangle_int_t rectangle = {
+                .x      = left,
+                .y      = top,
+                .width  = right  - left,
+                .height = bottom - top,
+        };
+        cairo_region_union_rectangle(damage, &rectangle);
+}
+
+/* Window_scrollArea
+ * Moves what was drawn in a rectangle of Window_context down by distance
+ * pixels, or up if distance is negative. Whatever is moved out of the rectangle
+ * is thrown away, and the strip it uncovers is left as it was, to be drawn
+ * over. The rectangle is rounded out to whole pixels, and all of it is damaged.
+ */
+void Window_scrollArea (
+        double x,         double y,
+        double areaWidth, double areaHeight,
+        int    distance
+) {
+        int left   = (int)(x);
+        int top    = (int)(y);
+        int right  = (int)(x + areaWidth)  + 1;
+        int bottom = (int)(y + areaHeight) + 1;
+        if (backBuffer == NULL) { return; }
+        Window_damage(x, y, areaWidth, areaHeight);
+
+        // nothing outside of the back buffer can be moved
+        if (left   < 0)      { left   = 0;      }
+        if (top    < 0)      { top    = 0;      }
+        if (right  > width)  { right  = width;  }
+        if (bottom > height) { bottom = height; }
+        if (left >= right)   { return; }
+
+        // only the part that stays inside the rectangle is copied
+        int amount = bottom - top - abs(distance);
+        if (amount <= 0 || distance == 0) { return; }
+        int from = top;
+        int to   = top;
+        if (distance > 0) { to   += distance; }
+        if (distance < 0) { from -= distance; }
+
+        cairo_surface_flush(backBuffer);
+        if (cairo_surface_get_type(backBuffer) == CAIRO_SURFACE_TYPE_IMAGE) {
+                // the pixels are right here, so they can just be moved. rows
+                // are gone through in the order that doesn't copy over any
+                // that haven't been moved yet.
+                unsigned char *data = cairo_image_surface_get_data(backBuffer);
+                size_t stride = (size_t)(cairo_image_surface_get_stride (
+                        backBuffer));
+                size_t offset = (size_t)(left)         * sizeof(uint32_t);
+                size_t length = (size_t)(right - left) * sizeof(uint32_t);
+
+                for (int index = 0; index < amount; index ++) {
+                        int row = index;
+                        if (distance > 0) { row = amount - 1 - index; }
+                        memmove (
+                                data + (size_t)(to   + row) * stride + offset,
+                                data + (size_t)(from + row) * stride + offset,
+                                length);
+                }
+
+                cairo_surface_mark_dirty_rectangle (
+                        backBuffer,
+                        left, top,
+                        right - left, bottom - top);
+                return;
+        }
+
+        // cairo doesn't say what happens when a surface is drawn onto itself,
+        // so the pixels go through another surface on the way. with a pixmap,
+        // both copies happen on the server.
+        cairo_surface_t *copy = cairo_surface_create_similar (
+                backBuffer,
+                CAIRO_CONTENT_COLOR,
+                right - left, amount);
+        cairo_t *copyContext = cairo_create(copy);
+        cairo_set_source_surface(copyContext, backBuffer, -left, -from);
+        cairo_set_operator(copyContext, CAIRO_OPERATOR_SOURCE);
+        cairo_paint(copyContext);
+        cairo_destroy(copyContext);
+
+        cairo_save(Window_context);
+        cairo_set_source_surface(Window_context, copy, left, to);
+        cairo_set_operator(Window_context, CAIRO_OPERATOR_SOURCE);
+        cairo_rectangle(Window_context, left, to, right - left, amount);
+        cairo_fill(Window_context);
+        cairo_restore(Window_context);
+        cairo_surface_destroy(copy);
+}
+
 /* Window_setTitle
  * Sets the title that will be displayed by the window manager.
  */
@@ -357,7 +1085,7 @@ Error Window_setTitle (const char *title) {
  * Sets the function to be called when the window is redrawn. The new window
  * dimensions are passed as width and height.
  */
-void Window_onRedraw (void (*callback) (int render, int width, int height)) {
+void Window_onRedraw (void (*callback) (int width, int height)) {
         callbacks.onRedraw = callback;
 }
 
@@ -368,7 +1096,6 @@ void Window_onRedraw (void (*callback) (int render, int width, int height)) {
  */
 void Window_onMouseButton (
         void (*callback) (
-                int                render,
                 Window_MouseButton button,
                 Window_State       state)
 ) {
@@ -379,17 +1106,33 @@ void Window_onMouseButton (
  * Sets the function to be called when the mouse is moved. The new mouse
  * position is passed as x and y.
  */
-void Window_onMouseMove (void (*callback) (int render, int x, int y)) {
+void Window_onMouseMove (void (*callback) (int x, int y)) {
         callbacks.onMouseMove = callback;
 }
 
 /* Window_onInterval
  * Sets the function to be called on an interval specified by Window_interval.
  */
-void Window_onInterval (void (*callback) (int render)) {
+void Window_onInterval (void (*callback) (void)) {
         callbacks.onInterval = callback;
 }
 
+/* Window_onWake
+ * Sets the function to be called on the main thread after Window_wake is
+ * called.
+ */
+void Window_onWake (void (*callback) (void)) {
+        callbacks.onWake = callback;
+}
+
+/* Window_onFrame
+ * Sets the function to be called to draw a frame, after one was asked for with
+ * Window_requestFrame. Everything should be drawn from within it.
+ */
+void Window_onFrame (void (*callback) (void)) {
+        callbacks.onFrame = callback;
+}
+
 /* Window_onKey
  * Sets the function to be called when a key is pressed or released. The Xlib
  * keysym that was pressed is passed as keySym, and whether it is pressed or
@@ -398,7 +1141,6 @@ void Window_onInterval (void (*callback) (int render)) {
  */
 void Window_onKey (
         void (*callback) (
-                int           render,
                 Window_KeySym keySym,
                 Rune          rune,
                 Window_State  state)